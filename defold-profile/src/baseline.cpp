@@ -0,0 +1,266 @@
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/log.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "baseline.h"
+
+// The file is a header (magic, version, frame count, entry count, all u32), followed by the entries,
+// sorted by path hash: u32 path hash, f64 mean, f64 max, f64 p95. In the native byte order.
+
+static const uint8_t    g_BaselineMagic[4] = { 'D', 'P', 'B', 'L' };
+static const uint32_t   g_BaselineVersion = 1;
+
+struct BaselineEntry
+{
+    uint32_t        m_PathHash;
+    BaselineStats   m_Stats;
+};
+
+struct Baseline
+{
+    char*           m_Name;
+    uint32_t        m_FrameCount;
+    uint32_t        m_Count;
+    BaselineEntry*  m_Entries;  // Sorted by path hash
+};
+
+static dmArray<Baseline>        g_Baselines;
+static dmArray<BaselineChange>  g_BaselineChanges;
+
+static Baseline* FindBaseline(const char* name)
+{
+    for (uint32_t i = 0; i < g_Baselines.Size(); ++i)
+    {
+        if (strcmp(g_Baselines[i].m_Name, name) == 0)
+            return &g_Baselines[i];
+    }
+    return 0;
+}
+
+static int CompareEntries(const void* a, const void* b)
+{
+    uint32_t hash_a = ((const BaselineEntry*)a)->m_PathHash;
+    uint32_t hash_b = ((const BaselineEntry*)b)->m_PathHash;
+    return hash_a < hash_b ? -1 : (hash_a > hash_b ? 1 : 0);
+}
+
+static const BaselineEntry* FindEntry(const Baseline* baseline, uint32_t path_hash)
+{
+    BaselineEntry key;
+    key.m_PathHash = path_hash;
+    return (const BaselineEntry*)bsearch(&key, baseline->m_Entries, baseline->m_Count, sizeof(BaselineEntry), CompareEntries);
+}
+
+// Takes ownership of the entries, and sorts them
+static void SetBaseline(const char* name, uint32_t frame_count, BaselineEntry* entries, uint32_t count)
+{
+    qsort(entries, count, sizeof(BaselineEntry), CompareEntries);
+
+    Baseline* baseline = FindBaseline(name);
+    if (baseline)
+    {
+        free(baseline->m_Entries);
+    }
+    else
+    {
+        if (g_Baselines.Full())
+            g_Baselines.OffsetCapacity(4);
+        g_Baselines.SetSize(g_Baselines.Size() + 1);
+        baseline = &g_Baselines.Back();
+        baseline->m_Name = strdup(name);
+    }
+    baseline->m_FrameCount  = frame_count;
+    baseline->m_Count       = count;
+    baseline->m_Entries     = entries;
+}
+
+static bool GetStats(HProperty property, BaselineStats* stats)
+{
+    PropertyHistoryStats history;
+    if (!PropertyGetHistoryStats(property, &history))
+        return false;
+    stats->m_Mean   = history.m_Mean;
+    stats->m_Max    = history.m_Max;
+    stats->m_P95    = history.m_P95;
+    return true;
+}
+
+bool BaselineSave(const char* name)
+{
+    uint32_t frame_count = PropertyGetHistorySize();
+    if (!frame_count)
+        return false;
+
+    const PropertyTreeNode* nodes;
+    uint32_t num_nodes = PropertyGetTree(&nodes);
+    BaselineEntry* entries = (BaselineEntry*)malloc(num_nodes * sizeof(BaselineEntry));
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < num_nodes; ++i)
+    {
+        BaselineEntry* entry = &entries[count];
+        if (!GetStats(nodes[i].m_Property, &entry->m_Stats))
+            continue; // A group
+        entry->m_PathHash = PropertyGetPathHash(nodes[i].m_Property);
+        ++count;
+    }
+
+    SetBaseline(name, frame_count, entries, count);
+    return true;
+}
+
+bool BaselineRemove(const char* name)
+{
+    Baseline* baseline = FindBaseline(name);
+    if (!baseline)
+        return false;
+
+    free(baseline->m_Name);
+    free(baseline->m_Entries);
+    g_Baselines.EraseSwap(baseline - g_Baselines.Begin());
+    return true;
+}
+
+uint32_t BaselineGetFrameCount(const char* name)
+{
+    Baseline* baseline = FindBaseline(name);
+    return baseline ? baseline->m_FrameCount : 0;
+}
+
+bool BaselineWrite(const char* name, const char* path)
+{
+    Baseline* baseline = FindBaseline(name);
+    if (!baseline)
+        return false;
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        dmLogError("Failed to open '%s'", path);
+        return false;
+    }
+
+    bool ok = fwrite(g_BaselineMagic, sizeof(g_BaselineMagic), 1, file) == 1;
+    ok = ok && fwrite(&g_BaselineVersion, sizeof(uint32_t), 1, file) == 1;
+    ok = ok && fwrite(&baseline->m_FrameCount, sizeof(uint32_t), 1, file) == 1;
+    ok = ok && fwrite(&baseline->m_Count, sizeof(uint32_t), 1, file) == 1;
+    for (uint32_t i = 0; ok && i < baseline->m_Count; ++i)
+    {
+        const BaselineEntry* entry = &baseline->m_Entries[i];
+        ok = fwrite(&entry->m_PathHash, sizeof(uint32_t), 1, file) == 1;
+        ok = ok && fwrite(&entry->m_Stats.m_Mean, sizeof(double), 1, file) == 1;
+        ok = ok && fwrite(&entry->m_Stats.m_Max, sizeof(double), 1, file) == 1;
+        ok = ok && fwrite(&entry->m_Stats.m_P95, sizeof(double), 1, file) == 1;
+    }
+
+    if (fclose(file) != 0)
+        ok = false;
+    if (!ok)
+        dmLogError("Failed to write the baseline to '%s'", path);
+    return ok;
+}
+
+bool BaselineRead(const char* name, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        dmLogError("Failed to open '%s'", path);
+        return false;
+    }
+
+    uint8_t magic[4];
+    uint32_t version = 0;
+    uint32_t frame_count = 0;
+    uint32_t count = 0;
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, g_BaselineMagic, sizeof(magic)) == 0;
+    ok = ok && fread(&version, sizeof(uint32_t), 1, file) == 1 && version == g_BaselineVersion;
+    ok = ok && fread(&frame_count, sizeof(uint32_t), 1, file) == 1;
+    ok = ok && fread(&count, sizeof(uint32_t), 1, file) == 1;
+
+    BaselineEntry* entries = ok ? (BaselineEntry*)malloc((count ? count : 1) * sizeof(BaselineEntry)) : 0;
+    ok = ok && entries != 0;
+    for (uint32_t i = 0; ok && i < count; ++i)
+    {
+        BaselineEntry* entry = &entries[i];
+        ok = fread(&entry->m_PathHash, sizeof(uint32_t), 1, file) == 1;
+        ok = ok && fread(&entry->m_Stats.m_Mean, sizeof(double), 1, file) == 1;
+        ok = ok && fread(&entry->m_Stats.m_Max, sizeof(double), 1, file) == 1;
+        ok = ok && fread(&entry->m_Stats.m_P95, sizeof(double), 1, file) == 1;
+    }
+    fclose(file);
+
+    if (!ok)
+    {
+        dmLogError("'%s' is not a valid baseline file", path);
+        free(entries);
+        return false;
+    }
+
+    SetBaseline(name, frame_count, entries, count);
+    return true;
+}
+
+// Relative to the baseline. A change from 0 is infinite
+static double GetRelativeChange(double baseline, double current)
+{
+    if (current == baseline)
+        return 0.0;
+    if (baseline == 0.0)
+        return current > baseline ? HUGE_VAL : -HUGE_VAL;
+    return (current - baseline) / fabs(baseline);
+}
+
+bool BaselineCompare(const char* name, double threshold, const BaselineChange** changes, uint32_t* count)
+{
+    Baseline* baseline = FindBaseline(name);
+    if (!baseline || !PropertyGetHistorySize())
+        return false;
+
+    g_BaselineChanges.SetSize(0);
+    const PropertyTreeNode* nodes;
+    uint32_t num_nodes = PropertyGetTree(&nodes);
+    for (uint32_t i = 0; i < num_nodes; ++i)
+    {
+        HProperty property = nodes[i].m_Property;
+        if (PropertyGetType(property) == PROFILE_PROPERTY_TYPE_GROUP)
+            continue;
+        const BaselineEntry* entry = FindEntry(baseline, PropertyGetPathHash(property));
+        if (!entry)
+            continue;
+
+        BaselineChange change;
+        if (!GetStats(property, &change.m_Current))
+            continue;
+
+        double mean_change = GetRelativeChange(entry->m_Stats.m_Mean, change.m_Current.m_Mean);
+        double p95_change = GetRelativeChange(entry->m_Stats.m_P95, change.m_Current.m_P95);
+        change.m_Change = fabs(mean_change) >= fabs(p95_change) ? mean_change : p95_change;
+        if (!(fabs(change.m_Change) > threshold))
+            continue;
+
+        change.m_Property = property;
+        change.m_Baseline = entry->m_Stats;
+        if (g_BaselineChanges.Full())
+            g_BaselineChanges.OffsetCapacity(64);
+        g_BaselineChanges.Push(change);
+    }
+
+    *changes = g_BaselineChanges.Begin();
+    *count = g_BaselineChanges.Size();
+    return true;
+}
+
+void BaselineFinalize()
+{
+    for (uint32_t i = 0; i < g_Baselines.Size(); ++i)
+    {
+        free(g_Baselines[i].m_Name);
+        free(g_Baselines[i].m_Entries);
+    }
+    g_Baselines.SetSize(0);
+    g_BaselineChanges.SetSize(0);
+}
@@ -0,0 +1,43 @@
+#ifndef DM_PROFILER_BASELINE_H
+#define DM_PROFILER_BASELINE_H
+
+#include "profiler.h"
+
+// Baselines: the history stats (profiler_counter.history_frames) of all properties, saved under a name,
+// to be compared with the stats of a later run (e.g. the same benchmark level on the next build).
+// The properties are matched by their path hash, so a baseline can be loaded into a build with other property indices.
+
+struct BaselineStats
+{
+    double  m_Mean;
+    double  m_Max;
+    double  m_P95;
+};
+
+struct BaselineChange
+{
+    HProperty       m_Property;
+    BaselineStats   m_Baseline;
+    BaselineStats   m_Current;
+    double          m_Change;   // The largest relative change of the mean and the p95, e.g. 0.25 for 25% higher
+};
+
+// Records the stats over the current history, replacing any earlier baseline with the same name.
+// Returns false if the history is disabled or empty
+bool        BaselineSave(const char* name);
+bool        BaselineRemove(const char* name);
+// Number of frames the baseline was recorded over, 0 if there's no baseline with the name
+uint32_t    BaselineGetFrameCount(const char* name);
+
+bool        BaselineWrite(const char* name, const char* path);
+// Loads a file written by BaselineWrite(), under the name
+bool        BaselineRead(const char* name, const char* path);
+
+// Compares the stats over the current history with the baseline. Only the properties that are in both,
+// and whose mean or p95 changed by more than the threshold (relative, e.g. 0.1 for 10%) are returned, in tree order.
+// The changes are valid until the next call. Returns false if there's no baseline with the name, or no history
+bool        BaselineCompare(const char* name, double threshold, const BaselineChange** changes, uint32_t* count);
+
+void        BaselineFinalize();
+
+#endif // DM_PROFILER_BASELINE_H
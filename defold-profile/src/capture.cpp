@@ -0,0 +1,411 @@
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/condition_variable.h>
+#include <dmsdk/dlib/log.h>
+#include <dmsdk/dlib/mutex.h>
+#include <dmsdk/dlib/thread.h>
+#include <dmsdk/dlib/time.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "capture_format.h"
+#include "profiler.h"
+
+// The main thread encodes the frames into the current block. When it's full, it's handed over to the writer thread,
+// and the main thread continues with the other block. If the writer thread is still busy with that block,
+// the frame is dropped instead of waiting for the disk.
+
+static const uint32_t   g_CaptureBlockSize = 256 * 1024;
+static const uint32_t   g_CaptureFlushFrames = 60; // Hand over the block at least this often, even if it isn't full
+
+struct CaptureBlock
+{
+    uint8_t*    m_Data;
+    uint32_t    m_Size;
+    uint32_t    m_Capacity;
+};
+
+struct CaptureValue
+{
+    ProfileIdx  m_Index;
+    uint64_t    m_Value;
+};
+
+static FILE*                                    g_CaptureFile = 0;
+static dmThread::Thread                         g_CaptureThread;
+static dmMutex::HMutex                          g_CaptureMutex = 0;
+static dmConditionVariable::HConditionVariable  g_CaptureCondition = 0;
+static CaptureBlock                             g_CaptureBlocks[2];
+static uint32_t                                 g_CaptureCurrentBlock = 0;  // Filled by the main thread
+static int32_t                                  g_CapturePendingBlock = -1; // Written by the writer thread, protected by g_CaptureMutex
+static bool                                     g_CaptureQuit = false;      // Protected by g_CaptureMutex
+static uint32_t                                 g_CaptureFramesSinceFlush = 0;
+
+// Encoder state, only used from the main thread.
+// The per property state is kept for the engine properties ([0]) and the extension properties ([1]) separately,
+// indexed from the first index of each, since the extension indices start far above the engine ones
+static dmArray<uint64_t>        g_CaptureLastValues[2]; // Last written value, per property
+static dmArray<uint8_t>         g_CaptureWritten[2];    // Has the property record been written, per property
+static dmArray<uint8_t>         g_CaptureRecord;
+static dmArray<uint8_t>         g_CaptureEntries;
+static dmArray<CaptureValue>    g_CaptureValues;        // Written to g_CaptureLastValues once the record is accepted
+static dmArray<ProfileIdx>      g_CaptureNewProperties; // Reverted if the record is dropped
+static uint32_t                 g_CaptureGeneration = 0;
+static uint32_t                 g_CaptureFrame = 0;
+static uint64_t                 g_CaptureTime = 0;
+static uint32_t                 g_CaptureDroppedFrames = 0;
+static bool                     g_CaptureResync = false; // Compare all properties, not only the ones that changed this frame
+
+// ****************************************************************************
+// Writer thread
+
+static void CaptureWriterThread(void* ctx)
+{
+    (void)ctx;
+    DM_MUTEX_SCOPED_LOCK(g_CaptureMutex);
+    while (true)
+    {
+        while (g_CapturePendingBlock < 0 && !g_CaptureQuit)
+            dmConditionVariable::Wait(g_CaptureCondition, g_CaptureMutex);
+
+        if (g_CapturePendingBlock < 0)
+            break;
+
+        CaptureBlock* block = &g_CaptureBlocks[g_CapturePendingBlock];
+
+        dmMutex::Unlock(g_CaptureMutex);
+        fwrite(block->m_Data, 1, block->m_Size, g_CaptureFile);
+        fflush(g_CaptureFile);
+        dmMutex::Lock(g_CaptureMutex);
+
+        block->m_Size = 0;
+        g_CapturePendingBlock = -1;
+    }
+}
+
+// Returns false if the writer thread is still busy with the other block
+static bool SubmitBlock()
+{
+    DM_MUTEX_SCOPED_LOCK(g_CaptureMutex);
+    if (g_CapturePendingBlock >= 0)
+        return false;
+
+    g_CapturePendingBlock = (int32_t)g_CaptureCurrentBlock;
+    g_CaptureCurrentBlock = 1 - g_CaptureCurrentBlock;
+    g_CaptureFramesSinceFlush = 0;
+    dmConditionVariable::Signal(g_CaptureCondition);
+    return true;
+}
+
+static bool AppendToBlock(const uint8_t* data, uint32_t size)
+{
+    CaptureBlock* block = &g_CaptureBlocks[g_CaptureCurrentBlock];
+    if (block->m_Size + size > block->m_Capacity)
+    {
+        if (block->m_Size > 0 && !SubmitBlock())
+            return false;
+
+        // The new current block is empty, but the record may still be larger than the block
+        block = &g_CaptureBlocks[g_CaptureCurrentBlock];
+        if (size > block->m_Capacity)
+        {
+            block->m_Data = (uint8_t*)realloc(block->m_Data, size);
+            block->m_Capacity = size;
+        }
+    }
+
+    memcpy(block->m_Data + block->m_Size, data, size);
+    block->m_Size += size;
+    return true;
+}
+
+// ****************************************************************************
+// Encoding
+
+static void WriteBytes(dmArray<uint8_t>& out, const void* data, uint32_t size)
+{
+    if (out.Remaining() < size)
+        out.OffsetCapacity(size + 4096);
+    out.PushArray((const uint8_t*)data, size);
+}
+
+static void WriteU8(dmArray<uint8_t>& out, uint8_t v)
+{
+    WriteBytes(out, &v, 1);
+}
+
+static void WriteVarint(dmArray<uint8_t>& out, uint64_t v)
+{
+    uint8_t buffer[10];
+    WriteBytes(out, buffer, CaptureWriteVarint(buffer, v));
+}
+
+static uint64_t GetCanonicalValue(ProfilePropertyType type, ProfilePropertyValue value)
+{
+    switch (type)
+    {
+        case PROFILE_PROPERTY_TYPE_BOOL:    return value.m_Bool ? 1 : 0;
+        case PROFILE_PROPERTY_TYPE_S32:     return (uint64_t)(int64_t)value.m_S32;
+        case PROFILE_PROPERTY_TYPE_U32:     return value.m_U32;
+        case PROFILE_PROPERTY_TYPE_F32:     { uint32_t bits; memcpy(&bits, &value.m_F32, sizeof(bits)); return bits; }
+        case PROFILE_PROPERTY_TYPE_S64:     return (uint64_t)value.m_S64;
+        case PROFILE_PROPERTY_TYPE_U64:     return value.m_U64;
+        case PROFILE_PROPERTY_TYPE_F64:     { uint64_t bits; memcpy(&bits, &value.m_F64, sizeof(bits)); return bits; }
+        default:                            return 0;
+    }
+}
+
+static void EnsureCaptureState(uint32_t state, uint32_t count)
+{
+    dmArray<uint64_t>& last_values = g_CaptureLastValues[state];
+    dmArray<uint8_t>& written = g_CaptureWritten[state];
+    uint32_t old_count = last_values.Size();
+    if (count <= old_count)
+        return;
+
+    last_values.SetCapacity(count);
+    last_values.SetSize(count);
+    written.SetCapacity(count);
+    written.SetSize(count);
+    memset(&last_values[old_count], 0, (count - old_count) * sizeof(uint64_t));
+    memset(&written[old_count], 0, count - old_count);
+}
+
+// Returns the state array the property is in, and its index in it
+static uint32_t GetCaptureState(HProperty property, uint32_t* index)
+{
+    uint32_t extension_first = PropertyGetExtensionFirst();
+    if (property < extension_first)
+    {
+        *index = property;
+        return 0;
+    }
+    *index = property - extension_first;
+    return 1;
+}
+
+static void WritePropertyRecords(HProperty first, uint32_t count)
+{
+    for (HProperty i = first; i < first + count; ++i)
+    {
+        uint32_t index;
+        uint32_t state = GetCaptureState(i, &index);
+        uint8_t* written = &g_CaptureWritten[state][index];
+        if (*written || !PropertyIsPublished(i))
+            continue;
+
+        HProperty parent = PropertyGetParent(i);
+        const char* name = PropertyGetName(i);
+        uint32_t name_length = (uint32_t)strlen(name);
+
+        WriteU8(g_CaptureRecord, CAPTURE_RECORD_PROPERTY);
+        WriteVarint(g_CaptureRecord, i);
+        WriteVarint(g_CaptureRecord, parent == PROFILE_PROPERTY_INVALID_IDX ? 0 : (uint64_t)parent + 1);
+        WriteU8(g_CaptureRecord, (uint8_t)PropertyGetType(i));
+        WriteVarint(g_CaptureRecord, PropertyGetFlags(i));
+        WriteVarint(g_CaptureRecord, name_length);
+        WriteBytes(g_CaptureRecord, name, name_length);
+
+        *written = 1;
+        if (g_CaptureNewProperties.Full())
+            g_CaptureNewProperties.OffsetCapacity(g_CaptureNewProperties.Capacity() + 64);
+        g_CaptureNewProperties.Push(i);
+    }
+}
+
+// Returns true if the value changed, and an entry was written
+static bool WriteValue(HProperty property, ProfileIdx* prev_index)
+{
+    uint32_t index;
+    uint32_t state = GetCaptureState(property, &index);
+    if (index >= g_CaptureWritten[state].Size() || !g_CaptureWritten[state][index])
+        return false;
+
+    ProfilePropertyType type = PropertyGetType(property);
+    if (type == PROFILE_PROPERTY_TYPE_GROUP)
+        return false;
+
+    uint64_t value = GetCanonicalValue(type, PropertyGetPrevValue(property));
+    uint64_t last = g_CaptureLastValues[state][index];
+    if (value == last)
+        return false;
+
+    WriteVarint(g_CaptureEntries, CaptureZigZagEncode((int64_t)property - (int64_t)*prev_index));
+    WriteVarint(g_CaptureEntries, CaptureIsFloatType(type) ? value ^ last : CaptureZigZagEncode((int64_t)(value - last)));
+    *prev_index = property;
+
+    CaptureValue entry = { property, value };
+    if (g_CaptureValues.Full())
+        g_CaptureValues.OffsetCapacity(g_CaptureValues.Capacity() + 256);
+    g_CaptureValues.Push(entry);
+    return true;
+}
+
+void CaptureFrameEnd()
+{
+    if (!g_CaptureFile)
+        return;
+
+    uint32_t count = PropertyGetCount();
+    HProperty extension_first = PropertyGetExtensionFirst();
+    uint32_t extension_count = PropertyGetExtensionCount();
+    EnsureCaptureState(0, count);
+    EnsureCaptureState(1, extension_count);
+
+    g_CaptureRecord.SetSize(0);
+    g_CaptureEntries.SetSize(0);
+    g_CaptureValues.SetSize(0);
+    g_CaptureNewProperties.SetSize(0);
+
+    if (g_CaptureDroppedFrames)
+    {
+        WriteU8(g_CaptureRecord, CAPTURE_RECORD_DROPPED);
+        WriteVarint(g_CaptureRecord, g_CaptureDroppedFrames);
+    }
+
+    uint32_t generation = PropertyGetTreeGeneration();
+    if (generation != g_CaptureGeneration)
+    {
+        WritePropertyRecords(0, count);
+        WritePropertyRecords(extension_first, extension_count);
+    }
+
+    uint32_t num_entries = 0;
+    ProfileIdx prev_index = 0;
+    if (g_CaptureResync)
+    {
+        for (HProperty i = 0; i < count; ++i)
+            num_entries += WriteValue(i, &prev_index) ? 1 : 0;
+        for (HProperty i = extension_first; i < extension_first + extension_count; ++i)
+            num_entries += WriteValue(i, &prev_index) ? 1 : 0;
+    }
+    else
+    {
+        const HProperty* changed;
+        uint32_t num_changed = PropertyGetChanged(&changed);
+        for (uint32_t i = 0; i < num_changed; ++i)
+            num_entries += WriteValue(changed[i], &prev_index) ? 1 : 0;
+    }
+
+    uint32_t frame = PropertyGetFrame();
+    uint64_t time = dmTime::GetTime();
+
+    WriteU8(g_CaptureRecord, CAPTURE_RECORD_FRAME);
+    WriteVarint(g_CaptureRecord, frame - g_CaptureFrame);
+    WriteVarint(g_CaptureRecord, time - g_CaptureTime);
+    WriteVarint(g_CaptureRecord, num_entries);
+    WriteBytes(g_CaptureRecord, g_CaptureEntries.Begin(), g_CaptureEntries.Size());
+
+    if (!AppendToBlock(g_CaptureRecord.Begin(), g_CaptureRecord.Size()))
+    {
+        // Nothing from this frame was written, so next time we need to compare against everything that was
+        for (uint32_t i = 0; i < g_CaptureNewProperties.Size(); ++i)
+        {
+            uint32_t index;
+            uint32_t state = GetCaptureState(g_CaptureNewProperties[i], &index);
+            g_CaptureWritten[state][index] = 0;
+        }
+        g_CaptureDroppedFrames++;
+        g_CaptureResync = true;
+        return;
+    }
+
+    for (uint32_t i = 0; i < g_CaptureValues.Size(); ++i)
+    {
+        uint32_t index;
+        uint32_t state = GetCaptureState(g_CaptureValues[i].m_Index, &index);
+        g_CaptureLastValues[state][index] = g_CaptureValues[i].m_Value;
+    }
+
+    g_CaptureGeneration = generation;
+    g_CaptureFrame = frame;
+    g_CaptureTime = time;
+    g_CaptureDroppedFrames = 0;
+    g_CaptureResync = false;
+
+    if (++g_CaptureFramesSinceFlush >= g_CaptureFlushFrames)
+        SubmitBlock();
+}
+
+// ****************************************************************************
+
+bool CaptureStart(const char* path)
+{
+    CaptureStop();
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        dmLogError("Failed to open capture file '%s'", path);
+        return false;
+    }
+
+    if (!g_CaptureMutex)
+    {
+        g_CaptureMutex = dmMutex::New();
+        g_CaptureCondition = dmConditionVariable::New();
+    }
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        g_CaptureBlocks[i].m_Data = (uint8_t*)malloc(g_CaptureBlockSize);
+        g_CaptureBlocks[i].m_Size = 0;
+        g_CaptureBlocks[i].m_Capacity = g_CaptureBlockSize;
+    }
+    g_CaptureCurrentBlock = 0;
+    g_CapturePendingBlock = -1;
+    g_CaptureQuit = false;
+    g_CaptureFramesSinceFlush = 0;
+
+    uint8_t header[5] = { CAPTURE_MAGIC[0], CAPTURE_MAGIC[1], CAPTURE_MAGIC[2], CAPTURE_MAGIC[3], CAPTURE_VERSION };
+    AppendToBlock(header, sizeof(header));
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        g_CaptureLastValues[i].SetSize(0);
+        g_CaptureWritten[i].SetSize(0);
+    }
+    g_CaptureGeneration = PropertyGetTreeGeneration() - 1; // Make sure the property records are written
+    g_CaptureFrame = PropertyGetFrame();
+    g_CaptureTime = dmTime::GetTime();
+    g_CaptureDroppedFrames = 0;
+    g_CaptureResync = true;
+
+    g_CaptureFile = file;
+    g_CaptureThread = dmThread::New(CaptureWriterThread, 0x10000, 0, "profile_capture");
+    dmLogInfo("Started profile capture to '%s'", path);
+    return true;
+}
+
+void CaptureStop()
+{
+    if (!g_CaptureFile)
+        return;
+
+    {
+        DM_MUTEX_SCOPED_LOCK(g_CaptureMutex);
+        g_CaptureQuit = true;
+        dmConditionVariable::Signal(g_CaptureCondition);
+    }
+    dmThread::Join(g_CaptureThread);
+
+    // The writer thread is done, so we can write the last block from here
+    CaptureBlock* block = &g_CaptureBlocks[g_CaptureCurrentBlock];
+    fwrite(block->m_Data, 1, block->m_Size, g_CaptureFile);
+    fclose(g_CaptureFile);
+    g_CaptureFile = 0;
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        free(g_CaptureBlocks[i].m_Data);
+        memset(&g_CaptureBlocks[i], 0, sizeof(CaptureBlock));
+    }
+    dmLogInfo("Stopped profile capture");
+}
+
+bool CaptureIsActive()
+{
+    return g_CaptureFile != 0;
+}
@@ -0,0 +1,14 @@
+#ifndef DM_PROFILER_CAPTURE_H
+#define DM_PROFILER_CAPTURE_H
+
+// Binary capture of the property values to a file (see capture_format.h).
+// The frames are encoded on the main thread, and written to disk by a background thread.
+
+bool    CaptureStart(const char* path);
+void    CaptureStop();
+bool    CaptureIsActive();
+
+// Called from FrameEnd, after the frame has been published
+void    CaptureFrameEnd();
+
+#endif // DM_PROFILER_CAPTURE_H
@@ -0,0 +1,97 @@
+#ifndef DM_PROFILER_CAPTURE_FORMAT_H
+#define DM_PROFILER_CAPTURE_FORMAT_H
+
+#include <stdint.h>
+
+// The binary capture format. Shared with the reader in tools/, so it must not depend on dmsdk.
+//
+// The file starts with the magic and version, followed by a stream of records, each starting with a record type byte:
+//
+//   CAPTURE_RECORD_PROPERTY    varint index, varint parent index + 1 (0 = no parent), u8 type, varint flags,
+//                              varint name length, name bytes
+//   CAPTURE_RECORD_FRAME       varint frame delta, varint time delta (microseconds), varint count,
+//                              count * (zigzag varint index delta, value delta)
+//   CAPTURE_RECORD_DROPPED     varint number of frames that were dropped, since the writer couldn't keep up
+//
+// The index is the property index: the engine properties are below 65536, the ones owned by the extension
+// (e.g. derived counters) are numbered from 65536.
+// A frame record only holds the properties whose value changed since they were last written.
+// The values are first converted to a 64 bit value: bool is 0 or 1, S32/S64 are sign extended,
+// U32/U64 are zero extended, and F32/F64 are the bits of the float. Then they are written as:
+//   integer and bool types: zigzag varint of the difference to the previous value
+//   float types: varint of the xor with the previous value
+// The previous value of a property is 0 before its first frame record.
+// After a dropped record, the next frame record holds all the properties that changed since the last written frame.
+
+static const uint8_t    CAPTURE_MAGIC[4] = { 'D', 'P', 'C', 'F' };
+static const uint8_t    CAPTURE_VERSION = 1;
+
+enum CaptureRecordType
+{
+    CAPTURE_RECORD_PROPERTY = 1,
+    CAPTURE_RECORD_FRAME    = 2,
+    CAPTURE_RECORD_DROPPED  = 3,
+};
+
+// Same values as ProfilePropertyType
+enum CaptureValueType
+{
+    CAPTURE_TYPE_BOOL,
+    CAPTURE_TYPE_S32,
+    CAPTURE_TYPE_U32,
+    CAPTURE_TYPE_F32,
+    CAPTURE_TYPE_S64,
+    CAPTURE_TYPE_U64,
+    CAPTURE_TYPE_F64,
+    CAPTURE_TYPE_GROUP,
+};
+
+static inline bool CaptureIsFloatType(uint8_t type)
+{
+    return type == CAPTURE_TYPE_F32 || type == CAPTURE_TYPE_F64;
+}
+
+static inline uint64_t CaptureZigZagEncode(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t CaptureZigZagDecode(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Writes at most 10 bytes, returns the number of bytes written
+static inline uint32_t CaptureWriteVarint(uint8_t* out, uint64_t v)
+{
+    uint32_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+// Returns the number of bytes read, or 0 if the buffer ended
+static inline uint32_t CaptureReadVarint(const uint8_t* in, const uint8_t* end, uint64_t* v)
+{
+    uint64_t result = 0;
+    uint32_t shift = 0;
+    const uint8_t* p = in;
+    while (p < end && shift < 64)
+    {
+        uint8_t b = *p++;
+        result |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+        {
+            *v = result;
+            return (uint32_t)(p - in);
+        }
+        shift += 7;
+    }
+    return 0;
+}
+
+#endif // DM_PROFILER_CAPTURE_FORMAT_H
@@ -0,0 +1,128 @@
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/mutex.h>
+#include <dmsdk/dlib/time.h>
+
+#include "derived.h"
+
+enum DerivedType
+{
+    DERIVED_RATE,
+    DERIVED_RATIO,
+    DERIVED_EMA,
+};
+
+struct DerivedCounter
+{
+    HProperty   m_Property;
+    HProperty   m_Sources[2];
+    DerivedType m_Type;
+    double      m_Alpha;
+    double      m_Last;     // The previous source value (rate), or the current average (ema)
+    bool        m_HasLast;
+};
+
+static dmMutex::HMutex          g_DerivedLock = 0;
+static dmArray<DerivedCounter>  g_DerivedCounters;
+static uint64_t                 g_DerivedTime = 0;
+
+static HProperty CreateDerived(const char* name, DerivedType type, HProperty source0, HProperty source1, double alpha, HProperty parent)
+{
+    if (!PropertyIsValid(source0) || (type == DERIVED_RATIO && !PropertyIsValid(source1)))
+        return PROFILE_PROPERTY_INVALID_IDX;
+
+    HProperty property = PropertyCreate(name, "", PROFILE_PROPERTY_TYPE_F64, 0, parent);
+    if (property == PROFILE_PROPERTY_INVALID_IDX)
+        return property;
+
+    DerivedCounter counter;
+    counter.m_Property      = property;
+    counter.m_Sources[0]    = source0;
+    counter.m_Sources[1]    = source1;
+    counter.m_Type          = type;
+    counter.m_Alpha         = alpha;
+    counter.m_Last          = 0.0;
+    counter.m_HasLast       = false;
+
+    DM_MUTEX_SCOPED_LOCK(g_DerivedLock);
+    if (g_DerivedCounters.Full())
+        g_DerivedCounters.OffsetCapacity(16);
+    g_DerivedCounters.Push(counter);
+    return property;
+}
+
+HProperty DerivedCreateRate(const char* name, HProperty source, HProperty parent)
+{
+    return CreateDerived(name, DERIVED_RATE, source, PROFILE_PROPERTY_INVALID_IDX, 0.0, parent);
+}
+
+HProperty DerivedCreateRatio(const char* name, HProperty numerator, HProperty denominator, HProperty parent)
+{
+    return CreateDerived(name, DERIVED_RATIO, numerator, denominator, 0.0, parent);
+}
+
+HProperty DerivedCreateEma(const char* name, HProperty source, double alpha, HProperty parent)
+{
+    if (alpha <= 0.0 || alpha > 1.0)
+        return PROFILE_PROPERTY_INVALID_IDX;
+    return CreateDerived(name, DERIVED_EMA, source, PROFILE_PROPERTY_INVALID_IDX, alpha, parent);
+}
+
+void DerivedFrameEnd()
+{
+    uint64_t time = dmTime::GetTime();
+    double dt = g_DerivedTime ? (time - g_DerivedTime) / 1000000.0 : 0.0;
+    g_DerivedTime = time;
+
+    DM_MUTEX_SCOPED_LOCK(g_DerivedLock);
+    for (uint32_t i = 0; i < g_DerivedCounters.Size(); ++i)
+    {
+        DerivedCounter* counter = &g_DerivedCounters[i];
+        double source = PropertyGetPrevNumber(counter->m_Sources[0]);
+        double result = 0.0;
+
+        switch (counter->m_Type)
+        {
+        case DERIVED_RATE:
+            {
+                // A frame reset source already holds the change during the frame
+                bool frame_reset = (PropertyGetFlags(counter->m_Sources[0]) & PROFILE_PROPERTY_FRAME_RESET) == PROFILE_PROPERTY_FRAME_RESET;
+                double delta = frame_reset ? source : source - counter->m_Last;
+                if (dt > 0.0 && (frame_reset || counter->m_HasLast))
+                    result = delta / dt;
+                counter->m_Last = source;
+                counter->m_HasLast = true;
+            }
+            break;
+
+        case DERIVED_RATIO:
+            {
+                double denominator = PropertyGetPrevNumber(counter->m_Sources[1]);
+                result = denominator != 0.0 ? source / denominator : 0.0;
+            }
+            break;
+
+        case DERIVED_EMA:
+            counter->m_Last = counter->m_HasLast ? counter->m_Alpha * source + (1.0 - counter->m_Alpha) * counter->m_Last : source;
+            counter->m_HasLast = true;
+            result = counter->m_Last;
+            break;
+        }
+
+        ProfilePropertyValue value;
+        value.m_F64 = result;
+        PropertySetFrameValue(counter->m_Property, value);
+    }
+}
+
+void DerivedInitialize()
+{
+    g_DerivedLock = dmMutex::New();
+    g_DerivedTime = 0;
+}
+
+void DerivedFinalize()
+{
+    dmMutex::Delete(g_DerivedLock);
+    g_DerivedLock = 0;
+    g_DerivedCounters.SetSize(0);
+}
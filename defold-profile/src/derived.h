@@ -0,0 +1,23 @@
+#ifndef DM_PROFILER_DERIVED_H
+#define DM_PROFILER_DERIVED_H
+
+#include "profiler.h"
+
+// Derived counters are F64 properties, calculated from other properties at the end of each frame.
+// They are evaluated in the order they were created, so a derived counter may use another one as its source.
+// Returns PROFILE_PROPERTY_INVALID_IDX if the property couldn't be created
+
+// Change per second of the source. For frame reset sources, the value of the frame per second
+HProperty   DerivedCreateRate(const char* name, HProperty source, HProperty parent);
+// numerator / denominator, or 0 if the denominator is 0
+HProperty   DerivedCreateRatio(const char* name, HProperty numerator, HProperty denominator, HProperty parent);
+// Exponential moving average of the source: value = alpha * source + (1 - alpha) * value
+HProperty   DerivedCreateEma(const char* name, HProperty source, double alpha, HProperty parent);
+
+void        DerivedInitialize();
+void        DerivedFinalize();
+
+// Called from FrameEnd, after the frame has been published
+void        DerivedFrameEnd();
+
+#endif // DM_PROFILER_DERIVED_H
@@ -0,0 +1,457 @@
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/log.h>
+#include <dmsdk/dlib/mutex.h>
+#include <dmsdk/dlib/thread.h>
+#include <dmsdk/dlib/time.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "http.h"
+#include "profiler.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// The main thread copies the frame into the snapshot that was published the least recently, and publishes it.
+// The server thread serializes from the published snapshot. If it's still busy with the snapshot the main thread
+// wants to write to, the frame is skipped, so neither thread waits for the other (or for g_Lock).
+
+struct HttpProperty
+{
+    HProperty   m_Property;
+    uint32_t    m_Path;         // Offset into m_Paths
+    uint32_t    m_GroupLength;  // Length of the group part of the path, without the trailing slash
+    uint8_t     m_Type;
+    uint8_t     m_Used;
+    double      m_Value;
+};
+
+struct HttpSnapshot
+{
+    dmArray<HttpProperty>   m_Properties;   // In tree order, without the groups
+    dmArray<char>           m_Paths;
+    uint32_t                m_Generation;   // The tree generation the properties were copied from
+    uint32_t                m_Frame;
+    uint64_t                m_Time;
+};
+
+static const int        g_HttpPollInterval = 100;   // ms, how often the server thread checks if it should stop
+static const int        g_HttpRequestTimeout = 2;   // s
+
+static int              g_HttpSocket = -1;
+static dmThread::Thread g_HttpThread;
+static dmMutex::HMutex  g_HttpLock = 0;
+static HttpSnapshot     g_HttpSnapshots[2];
+static int32_t          g_HttpFront = -1;       // The last published snapshot, protected by g_HttpLock
+static int32_t          g_HttpReading = -1;     // The snapshot being serialized, protected by g_HttpLock
+static bool             g_HttpQuit = false;     // Protected by g_HttpLock
+
+// Only used from the server thread
+static dmArray<char>    g_HttpResponse;
+
+static void CopyProperties(HttpSnapshot* snapshot)
+{
+    snapshot->m_Properties.SetSize(0);
+    snapshot->m_Paths.SetSize(0);
+
+    const PropertyTreeNode* nodes;
+    uint32_t num_nodes = PropertyGetTree(&nodes);
+    char path[256];
+    for (uint32_t i = 0; i < num_nodes; ++i)
+    {
+        HProperty property = nodes[i].m_Property;
+        ProfilePropertyType type = PropertyGetType(property);
+        if (type == PROFILE_PROPERTY_TYPE_GROUP)
+            continue;
+
+        PropertyGetPath(property, path, sizeof(path));
+        uint32_t length = (uint32_t)strlen(path) + 1;
+        const char* separator = strrchr(path, '/');
+
+        HttpProperty entry;
+        entry.m_Property    = property;
+        entry.m_Path        = snapshot->m_Paths.Size();
+        entry.m_GroupLength = separator ? (uint32_t)(separator - path) : 0;
+        entry.m_Type        = (uint8_t)type;
+        entry.m_Used        = 0;
+        entry.m_Value       = 0.0;
+
+        if (snapshot->m_Properties.Full())
+            snapshot->m_Properties.OffsetCapacity(256);
+        snapshot->m_Properties.Push(entry);
+
+        if (snapshot->m_Paths.Remaining() < length)
+            snapshot->m_Paths.OffsetCapacity(length > 4096 ? length : 4096);
+        snapshot->m_Paths.PushArray(path, length);
+    }
+    snapshot->m_Generation = PropertyGetTreeGeneration();
+}
+
+void HttpFrameEnd()
+{
+    if (g_HttpSocket < 0)
+        return;
+
+    int32_t back;
+    {
+        DM_MUTEX_SCOPED_LOCK(g_HttpLock);
+        back = g_HttpFront == 0 ? 1 : 0;
+        if (back == g_HttpReading)
+            return;
+    }
+
+    HttpSnapshot* snapshot = &g_HttpSnapshots[back];
+    if (snapshot->m_Generation != PropertyGetTreeGeneration())
+        CopyProperties(snapshot);
+
+    for (uint32_t i = 0; i < snapshot->m_Properties.Size(); ++i)
+    {
+        HttpProperty* entry = &snapshot->m_Properties[i];
+        entry->m_Value  = PropertyGetPrevNumber(entry->m_Property);
+        entry->m_Used   = PropertyGetPrevUsed(entry->m_Property) ? 1 : 0;
+    }
+    snapshot->m_Frame   = PropertyGetFrame();
+    snapshot->m_Time    = dmTime::GetTime();
+
+    DM_MUTEX_SCOPED_LOCK(g_HttpLock);
+    g_HttpFront = back;
+}
+
+// ****************************************************************************
+// Serialization
+
+static void Append(const char* text, uint32_t length)
+{
+    if (g_HttpResponse.Remaining() < length)
+        g_HttpResponse.OffsetCapacity(length > 16384 ? length : 16384);
+    g_HttpResponse.PushArray(text, length);
+}
+
+static void Append(const char* text)
+{
+    Append(text, (uint32_t)strlen(text));
+}
+
+// Escapes the characters that aren't allowed in a Prometheus label value, or a json string (which escapes the same ones)
+static void AppendEscaped(const char* text, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        char c = text[i];
+        if (c == '"' || c == '\\')
+        {
+            char escaped[2] = { '\\', c };
+            Append(escaped, 2);
+        }
+        else if (c == '\n')
+            Append("\\n", 2);
+        else if ((unsigned char)c >= 0x20)
+            Append(&c, 1);
+    }
+}
+
+static void AppendNumber(double value)
+{
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%.17g", value);
+    Append(buffer, (uint32_t)length);
+}
+
+// The Prometheus text format spells the non finite values differently from printf
+static void AppendMetricNumber(double value)
+{
+    if (isnan(value))
+        Append("NaN");
+    else if (isinf(value))
+        Append(value > 0 ? "+Inf" : "-Inf");
+    else
+        AppendNumber(value);
+}
+
+static const char* GetTypeName(uint8_t type)
+{
+    switch (type)
+    {
+        case PROFILE_PROPERTY_TYPE_BOOL:    return "bool";
+        case PROFILE_PROPERTY_TYPE_S32:     return "s32";
+        case PROFILE_PROPERTY_TYPE_U32:     return "u32";
+        case PROFILE_PROPERTY_TYPE_S64:     return "s64";
+        case PROFILE_PROPERTY_TYPE_U64:     return "u64";
+        case PROFILE_PROPERTY_TYPE_F32:     return "f32";
+        case PROFILE_PROPERTY_TYPE_F64:     return "f64";
+        default:                            return "unknown";
+    }
+}
+
+// One gauge with the path, group, and type as labels
+static void WritePrometheus(const HttpSnapshot* snapshot)
+{
+    Append("# HELP defold_profile_frames_total Number of published frames\n");
+    Append("# TYPE defold_profile_frames_total counter\n");
+    Append("defold_profile_frames_total ");
+    AppendNumber(snapshot->m_Frame);
+    Append("\n# HELP defold_profile_property Value of the profiler property during the last frame\n");
+    Append("# TYPE defold_profile_property gauge\n");
+
+    for (uint32_t i = 0; i < snapshot->m_Properties.Size(); ++i)
+    {
+        const HttpProperty* entry = &snapshot->m_Properties[i];
+        const char* path = &snapshot->m_Paths[entry->m_Path];
+        Append("defold_profile_property{path=\"");
+        AppendEscaped(path, (uint32_t)strlen(path));
+        Append("\",group=\"");
+        AppendEscaped(path, entry->m_GroupLength);
+        Append("\",type=\"");
+        Append(GetTypeName(entry->m_Type));
+        Append("\"} ");
+        AppendMetricNumber(entry->m_Value);
+        Append("\n");
+    }
+}
+
+// {"frame": 123, "time": 1700000000000000, "properties": [{"path": "Physics/Contacts", "group": "Physics", "type": "u32", "value": 12, "used": true}, ...]}
+static void WriteJson(const HttpSnapshot* snapshot)
+{
+    Append("{\"frame\":");
+    AppendNumber(snapshot->m_Frame);
+    Append(",\"time\":");
+    AppendNumber((double)snapshot->m_Time);
+    Append(",\"properties\":[");
+
+    for (uint32_t i = 0; i < snapshot->m_Properties.Size(); ++i)
+    {
+        const HttpProperty* entry = &snapshot->m_Properties[i];
+        const char* path = &snapshot->m_Paths[entry->m_Path];
+        Append(i ? ",{\"path\":\"" : "{\"path\":\"");
+        AppendEscaped(path, (uint32_t)strlen(path));
+        Append("\",\"group\":\"");
+        AppendEscaped(path, entry->m_GroupLength);
+        Append("\",\"type\":\"");
+        Append(GetTypeName(entry->m_Type));
+        Append("\",\"value\":");
+        if (isfinite(entry->m_Value)) // Not representable in json
+            AppendNumber(entry->m_Value);
+        else
+            Append("null");
+        Append(entry->m_Used ? ",\"used\":true}" : ",\"used\":false}");
+    }
+    Append("]}\n");
+}
+
+// ****************************************************************************
+// Server
+
+static void SendAll(int client, const char* data, uint32_t size)
+{
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL; // A client that disconnects early mustn't raise SIGPIPE
+#else
+    const int flags = 0;
+#endif
+    while (size)
+    {
+        ssize_t sent = send(client, data, size, flags);
+        if (sent <= 0)
+            return;
+        data += sent;
+        size -= (uint32_t)sent;
+    }
+}
+
+static void SendResponse(int client, const char* status, const char* content_type)
+{
+    char header[256];
+    int length = snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+                            status, content_type, g_HttpResponse.Size());
+    SendAll(client, header, (uint32_t)length);
+    SendAll(client, g_HttpResponse.Begin(), g_HttpResponse.Size());
+}
+
+static void HandleRequest(int client)
+{
+    struct timeval timeout = { g_HttpRequestTimeout, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#if defined(SO_NOSIGPIPE)
+    int one = 1;
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    // Reads the headers too, since closing the socket with unread data would reset the connection
+    char request[2048];
+    uint32_t size = 0;
+    request[0] = 0;
+    while (size < sizeof(request) - 1 && !strstr(request, "\r\n\r\n"))
+    {
+        ssize_t received = recv(client, request + size, sizeof(request) - 1 - size, 0);
+        if (received <= 0)
+            break;
+        size += (uint32_t)received;
+        request[size] = 0;
+    }
+
+    g_HttpResponse.SetSize(0);
+    if (strncmp(request, "GET ", 4) != 0)
+    {
+        Append("Only GET is supported\n");
+        SendResponse(client, "405 Method Not Allowed", "text/plain");
+        return;
+    }
+
+    const char* target = request + 4;
+    uint32_t target_length = (uint32_t)strcspn(target, " ?\r\n");
+    bool prometheus = target_length == 8 && strncmp(target, "/metrics", 8) == 0;
+    bool json = target_length == 5 && strncmp(target, "/json", 5) == 0;
+    if (!prometheus && !json)
+    {
+        Append("Use /metrics or /json\n");
+        SendResponse(client, "404 Not Found", "text/plain");
+        return;
+    }
+
+    int32_t index;
+    {
+        DM_MUTEX_SCOPED_LOCK(g_HttpLock);
+        index = g_HttpFront;
+        g_HttpReading = index;
+    }
+    if (index < 0)
+    {
+        Append("No frame has been published yet\n");
+        SendResponse(client, "503 Service Unavailable", "text/plain");
+        return;
+    }
+
+    if (prometheus)
+        WritePrometheus(&g_HttpSnapshots[index]);
+    else
+        WriteJson(&g_HttpSnapshots[index]);
+
+    {
+        DM_MUTEX_SCOPED_LOCK(g_HttpLock);
+        g_HttpReading = -1;
+    }
+    SendResponse(client, "200 OK", prometheus ? "text/plain; version=0.0.4" : "application/json");
+}
+
+static void HttpServerThread(void* ctx)
+{
+    (void)ctx;
+    for (;;)
+    {
+        {
+            DM_MUTEX_SCOPED_LOCK(g_HttpLock);
+            if (g_HttpQuit)
+                break;
+        }
+
+        struct pollfd fd;
+        fd.fd       = g_HttpSocket;
+        fd.events   = POLLIN;
+        fd.revents  = 0;
+        if (poll(&fd, 1, g_HttpPollInterval) <= 0)
+            continue;
+
+        int client = accept(g_HttpSocket, 0, 0);
+        if (client < 0)
+            continue;
+        HandleRequest(client);
+        close(client);
+    }
+}
+
+bool HttpStart(const char* address, uint16_t port)
+{
+    HttpStop();
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+    {
+        dmLogError("Invalid http address '%s'", address);
+        return false;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        dmLogError("Failed to create the http socket");
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0)
+    {
+        dmLogError("Failed to listen on %s:%u", address, port);
+        close(fd);
+        return false;
+    }
+
+    if (!g_HttpLock)
+        g_HttpLock = dmMutex::New();
+
+    // Make sure the properties are copied
+    for (uint32_t i = 0; i < 2; ++i)
+        g_HttpSnapshots[i].m_Generation = PropertyGetTreeGeneration() - 1;
+    g_HttpFront = -1;
+    g_HttpReading = -1;
+    g_HttpQuit = false;
+
+    g_HttpSocket = fd;
+    g_HttpThread = dmThread::New(HttpServerThread, 0x10000, 0, "profile_http");
+    dmLogInfo("Serving the profile counters on http://%s:%u/metrics and /json", address, port);
+    return true;
+}
+
+void HttpStop()
+{
+    if (g_HttpSocket < 0)
+        return;
+
+    {
+        DM_MUTEX_SCOPED_LOCK(g_HttpLock);
+        g_HttpQuit = true;
+    }
+    dmThread::Join(g_HttpThread);
+    close(g_HttpSocket);
+    g_HttpSocket = -1;
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        g_HttpSnapshots[i].m_Properties.SetSize(0);
+        g_HttpSnapshots[i].m_Properties.SetCapacity(0);
+        g_HttpSnapshots[i].m_Paths.SetSize(0);
+        g_HttpSnapshots[i].m_Paths.SetCapacity(0);
+    }
+    g_HttpResponse.SetSize(0);
+    g_HttpResponse.SetCapacity(0);
+}
+
+#else
+
+bool HttpStart(const char* address, uint16_t port)
+{
+    dmLogWarning("The http server is not supported on this platform");
+    return false;
+}
+
+void HttpStop()
+{
+}
+
+void HttpFrameEnd()
+{
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef DM_PROFILER_HTTP_H
+#define DM_PROFILER_HTTP_H
+
+#include <stdint.h>
+
+// Serves the values of the last frame over http, as Prometheus text (/metrics) and as json (/json).
+// The values are copied at the end of the frame, and the requests are served from a separate thread.
+// Only supported on Linux and macOS, the functions do nothing on the other platforms.
+
+bool    HttpStart(const char* address, uint16_t port);
+void    HttpStop();
+
+// Called from FrameEnd, after the frame has been published
+void    HttpFrameEnd();
+
+#endif // DM_PROFILER_HTTP_H
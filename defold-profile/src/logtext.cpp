@@ -0,0 +1,132 @@
+#include <dmsdk/dlib/time.h>
+
+#include <atomic>
+#include <stdlib.h> // calloc
+#include <string.h>
+
+#include "logtext.h"
+#include "profiler.h"
+#include "threads.h"
+
+// Any number of threads write to the ring buffer at the same time: each one reserves a position by incrementing the head,
+// and writes the slot at that position. The sequence of a slot tells the readers which position it holds,
+// and that it isn't being written. A reader copies the slot, and discards it if the sequence changed meanwhile.
+// The fields are atomics, so the copy is well defined even when it races with a writer.
+
+static const uint32_t g_LogTextWords = LOGTEXT_MAX_LENGTH / sizeof(uint64_t);
+
+struct LogTextSlot
+{
+    std::atomic<uint64_t>   m_Sequence; // position * 2 + 1 while it's written, position * 2 + 2 once it's done
+    std::atomic<uint32_t>   m_Frame;
+    std::atomic<uint32_t>   m_Thread;
+    std::atomic<uint64_t>   m_Text[g_LogTextWords];
+};
+
+static std::atomic<LogTextSlot*> g_LogTextSlots(0);
+static uint32_t                 g_LogTextCapacity = 0;
+static std::atomic<uint32_t>    g_LogTextWriters(0); // The LogTextAdd calls in flight, drained before the slots are freed
+static std::atomic<uint64_t>    g_LogTextHead;      // The next position to write
+static std::atomic<uint32_t>    g_LogTextFrame;     // The frame being recorded
+
+void LogTextAdd(const char* text)
+{
+    // Announced before the slots are loaded, so LogTextFinalize either sees the writer, or the writer sees no slots
+    g_LogTextWriters.fetch_add(1);
+    LogTextSlot* slots = g_LogTextSlots.load();
+    if (!slots)
+    {
+        g_LogTextWriters.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    uint64_t words[g_LogTextWords];
+    memset(words, 0, sizeof(words));
+    size_t length = strlen(text);
+    memcpy(words, text, length < LOGTEXT_MAX_LENGTH - 1 ? length : LOGTEXT_MAX_LENGTH - 1);
+
+    uint64_t position = g_LogTextHead.fetch_add(1, std::memory_order_relaxed);
+    LogTextSlot* slot = &slots[position & (g_LogTextCapacity - 1)];
+    slot->m_Sequence.store(position * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->m_Frame.store(g_LogTextFrame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    slot->m_Thread.store(ThreadsGetId(), std::memory_order_relaxed);
+    for (uint32_t i = 0; i < g_LogTextWords; ++i)
+        slot->m_Text[i].store(words[i], std::memory_order_relaxed);
+
+    slot->m_Sequence.store(position * 2 + 2, std::memory_order_release);
+    g_LogTextWriters.fetch_sub(1, std::memory_order_release);
+}
+
+void LogTextFrameEnd()
+{
+    g_LogTextFrame.store(PropertyGetFrame() + 1, std::memory_order_relaxed);
+}
+
+uint32_t LogTextGetCapacity()
+{
+    return g_LogTextCapacity;
+}
+
+uint32_t LogTextGet(uint32_t first_frame, uint32_t last_frame, LogTextEntry* entries, uint32_t max_count)
+{
+    LogTextSlot* slots = g_LogTextSlots.load(std::memory_order_acquire);
+    if (!slots)
+        return 0;
+
+    uint64_t head = g_LogTextHead.load(std::memory_order_acquire);
+    uint64_t position = head > g_LogTextCapacity ? head - g_LogTextCapacity : 0;
+    uint32_t count = 0;
+    for (; position < head && count < max_count; ++position)
+    {
+        LogTextSlot* slot = &slots[position & (g_LogTextCapacity - 1)];
+        uint64_t sequence = slot->m_Sequence.load(std::memory_order_acquire);
+        if (sequence != position * 2 + 2)
+            continue; // Still being written, or already overwritten
+
+        LogTextEntry* entry = &entries[count];
+        entry->m_Frame  = slot->m_Frame.load(std::memory_order_relaxed);
+        entry->m_Thread = slot->m_Thread.load(std::memory_order_relaxed);
+        uint64_t words[g_LogTextWords];
+        for (uint32_t i = 0; i < g_LogTextWords; ++i)
+            words[i] = slot->m_Text[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->m_Sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+        if (entry->m_Frame < first_frame || entry->m_Frame > last_frame)
+            continue;
+
+        memcpy(entry->m_Text, words, sizeof(entry->m_Text));
+        entry->m_Text[LOGTEXT_MAX_LENGTH - 1] = 0;
+        ++count;
+    }
+    return count;
+}
+
+void LogTextInitialize(uint32_t capacity)
+{
+    g_LogTextHead.store(0);
+    g_LogTextFrame.store(PropertyGetFrame() + 1);
+    if (!capacity)
+        return;
+
+    uint32_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+
+    // The slots are written from other threads before they're read, and the sequences are 0 (never written)
+    g_LogTextCapacity = size;
+    g_LogTextSlots.store((LogTextSlot*)calloc(size, sizeof(LogTextSlot)));
+}
+
+// The writers don't take a lock, so the slots are unpublished first, and then freed once the writers that already loaded them are done
+void LogTextFinalize()
+{
+    LogTextSlot* slots = g_LogTextSlots.exchange(0);
+    while (g_LogTextWriters.load(std::memory_order_acquire))
+        dmTime::Sleep(100);
+    g_LogTextCapacity = 0;
+    free(slots);
+}
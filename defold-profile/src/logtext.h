@@ -0,0 +1,33 @@
+#ifndef DM_PROFILER_LOGTEXT_H
+#define DM_PROFILER_LOGTEXT_H
+
+#include <stdint.h>
+
+// The profiler log markers (LogText), kept in a fixed size ring buffer together with the frame and the thread that logged them.
+// When the buffer is full, the oldest entries are overwritten.
+
+static const uint32_t LOGTEXT_MAX_LENGTH = 128; // Including the terminating zero, longer texts are truncated
+
+struct LogTextEntry
+{
+    uint32_t    m_Frame;    // The PropertyGetFrame() the frame is published as
+    uint32_t    m_Thread;   // See ThreadsGetNameById()
+    char        m_Text[LOGTEXT_MAX_LENGTH];
+};
+
+// The capacity is rounded up to a power of two. 0 disables the log
+void        LogTextInitialize(uint32_t capacity);
+void        LogTextFinalize();
+
+// May be called from any thread. No locks, and no allocations
+void        LogTextAdd(const char* text);
+
+// Called from FrameEnd, after the frame has been published
+void        LogTextFrameEnd();
+
+uint32_t    LogTextGetCapacity();
+// Copies the entries logged during the frames first_frame to last_frame (inclusive), oldest first.
+// Returns the number of entries
+uint32_t    LogTextGet(uint32_t first_frame, uint32_t last_frame, LogTextEntry* entries, uint32_t max_count);
+
+#endif // DM_PROFILER_LOGTEXT_H
@@ -1,48 +1,233 @@
+#include <dmsdk/dlib/array.h>
 #include <dmsdk/dlib/atomic.h>
+#include <dmsdk/dlib/dstrings.h>
+#include <dmsdk/dlib/configfile.h>
 #include <dmsdk/dlib/hash.h>
+#include <dmsdk/dlib/hashtable.h>
 #include <dmsdk/dlib/log.h>
 #include <dmsdk/dlib/mutex.h>
 #include <dmsdk/dlib/profile.h>
+#include <dmsdk/dlib/time.h>
 #include <dmsdk/extension/extension.h>
 
+#include <atomic>
+#include <math.h> // HUGE_VAL
 #include <stdio.h>
-#include <stdlib.h> // rand
+#include <stdlib.h> // rand, qsort
 #include <string.h> // memset
 
+#include "baseline.h"
+#include "capture.h"
+#include "derived.h"
+#include "http.h"
+#include "logtext.h"
 #include "profiler.h"
+#include "scopes.h"
+#include "shm.h"
 #include "script.h"
+#include "selfstats.h"
+#include "threads.h"
+#include "triggers.h"
 
 // NOTE: This is mostly copied from profiler_basic.cpp in the Defold repo.
 
 // ****************************************************************************
 
+// The cold part of a property, only used when registering and browsing the properties
 struct Property
 {
     const char*             m_Name;
     const char*             m_Description;
     uint32_t                m_NameHash;
-    uint32_t                m_Flags;
+    uint32_t                m_PathHash; // Hash of the full path, e.g. "Physics/Contacts"
     ProfileIdx              m_Parent;
     ProfileIdx              m_Sibling;
     ProfileIdx              m_FirstChild;
-    ProfilePropertyValue    m_DefaultValue;
-    ProfilePropertyType     m_Type;
+    ProfileIdx              m_LastChild;
+    uint32_t                m_TreePosition; // Position in g_PropertyTree, g_InvalidTreePosition until it's rebuilt
+};
+
+// The live value slot is written from any thread without taking g_Lock.
+// It holds the raw bits of a ProfilePropertyValue, since dmAtomic only covers 32 bit integers.
+// Each slot gets its own cache line, so threads writing different properties don't contend.
+static const uint32_t   g_CacheLineSize = 64;
+
+// Distribution of the Add calls during the frame, for the properties that have it enabled.
+// Each field is updated atomically, but not together, so an Add that races with FrameEnd may be split over two frames.
+struct AddStats
+{
+    std::atomic<uint32_t>   m_Count;
+    std::atomic<uint64_t>   m_Min;      // Bits of a double
+    std::atomic<uint64_t>   m_Max;      // Bits of a double
+    std::atomic<uint32_t>   m_Buckets[PROPERTY_ADD_STATS_BUCKETS];
+    PropertyAddStats        m_Published;
+};
+
+// Per thread values, for the properties that have them enabled.
+// Each thread only writes to its own slot, on its own cache line, so the Add calls from different threads don't contend.
+enum ThreadValueUsage
+{
+    THREAD_VALUE_ADDED  = 1,
+    THREAD_VALUE_SET    = 2,
+};
+
+struct ThreadValue
+{
+    std::atomic<uint64_t>   m_Add;      // The sum of the Add calls during the frame, as bits of the property type
+    std::atomic<uint64_t>   m_Set;      // The last Set value, as bits
+    std::atomic<uint32_t>   m_Used;     // ThreadValueUsage
+    uint8_t                 m_Pad[g_CacheLineSize - 2 * sizeof(uint64_t) - sizeof(uint32_t)];
+};
+static_assert(sizeof(ThreadValue) == g_CacheLineSize, "ThreadValue must fill a cache line");
+
+struct ThreadValues
+{
+    ThreadValue             m_Threads[THREADS_SLOT_COUNT];
+    // The threads that wrote to the property in frame m_PublishedFrame
+    uint32_t                m_PublishedFrame;
+    uint32_t                m_PublishedCount;
+    uint32_t                m_PublishedThreads[THREADS_SLOT_COUNT];
+    double                  m_PublishedValues[THREADS_SLOT_COUNT];
 };
 
 struct PropertyData
 {
-    ProfilePropertyValue    m_Value;
-    ProfilePropertyValue    m_PrevValue; // This is the one that we collect from the script function
-    uint8_t                 m_Used : 1;
-    uint8_t                 m_PrevUsed : 1;
+    std::atomic<uint64_t>   m_Value;
+    std::atomic<uint32_t>   m_Used;             // PropertyUsage, non zero while the property is in the dirty list
+    std::atomic<ProfileIdx> m_NextDirty;
+    std::atomic<AddStats*>  m_AddStats;         // Null unless enabled with PropertyEnableAddStats()
+    std::atomic<ThreadValues*> m_ThreadValues;  // Null unless enabled with PropertyEnableThreadValues()
+    uint8_t                 m_Pad[g_CacheLineSize - sizeof(uint64_t) - 2 * sizeof(uint32_t) - 2 * sizeof(void*)];
+};
+static_assert(sizeof(PropertyData) == g_CacheLineSize, "PropertyData must fill a cache line");
+
+enum PropertyUsage
+{
+    PROPERTY_UNUSED = 0,
+    PROPERTY_USED   = 1,
+    PROPERTY_RESET  = 2,
 };
 
-static dmMutex::HMutex  g_Lock = 0;
-static int32_atomic_t   g_ProfileInitialized = 0;
-static int32_atomic_t   g_PropertyInitialized = 0;
-static const uint32_t   g_MaxPropertyCount = 256;
-static Property         g_Properties[g_MaxPropertyCount];
-static PropertyData     g_PropertyData[g_MaxPropertyCount];
+// The properties are stored in pages, allocated when the first property in the page is registered.
+// A page is never moved or freed, so the pointers that the writer threads hold stay valid.
+static const uint32_t   g_PropertyPageShift = 8;
+static const uint32_t   g_PropertyPageSize = 1 << g_PropertyPageShift;
+static const uint32_t   g_PropertyPageMask = g_PropertyPageSize - 1;
+static const uint32_t   g_MaxPropertyPageCount = 256;
+
+// The extension's own properties (see PropertyCreate) have their own pages above the engine's, so the engine can't
+// register a property at one of their indices, however many it registers
+static const uint32_t   g_ExtensionPropertyPageCount = 16;
+static const uint32_t   g_ExtensionPropertyFirst = g_MaxPropertyPageCount * g_PropertyPageSize;
+static const uint32_t   g_ExtensionPropertyMax = g_ExtensionPropertyPageCount * g_PropertyPageSize;
+static const uint32_t   g_PropertyPageCount = g_MaxPropertyPageCount + g_ExtensionPropertyPageCount;
+
+// Roll-up of the numeric descendants of a group
+struct GroupRollup
+{
+    PropertyRollup  m_Rollup;
+    uint32_t        m_DirtyFrame;   // The frame a descendant last changed
+};
+
+// Accumulates the frame values of a property over the current window.
+// The value only changes in the frames the property is in the changed list, so the sum is
+// brought up to date then, and when the window closes, instead of every frame.
+struct WindowStats
+{
+    double              m_Sum;
+    double              m_Max;
+    double              m_Value;            // The value since frame m_Since of the window
+    uint32_t            m_Since;
+    uint32_t            m_Start;            // The first frame of the window the property was registered in
+    uint32_t            m_Window;           // The window being accumulated, 0 until the property is seen
+    uint32_t            m_PublishedWindow;
+    PropertyWindowStats m_Published;
+};
+
+// The page is laid out as columns, so the per frame passes only touch the fields they need.
+// Everything except m_Data is only accessed from the main thread (or with g_Lock held).
+// The passes that run after the frame is published don't hold the lock, so they only look at the published
+// properties (m_Published), and not at the child links, which a registration on another thread may update.
+
+struct PropertyPage
+{
+    PropertyData    m_Data[g_PropertyPageSize];                 // Must be first, to keep the cache line alignment
+    uint64_t        m_Snapshot[2][g_PropertyPageSize];          // The published values (as bits), per snapshot buffer
+    uint64_t        m_DefaultValue[g_PropertyPageSize];         // As bits
+    uint32_t        m_Flags[g_PropertyPageSize];
+    uint32_t        m_ChangedFrame[g_PropertyPageSize];         // Last frame the property was added to a changed list
+    uint32_t        m_SubtreeUsedFrame[g_PropertyPageSize];     // Last frame a descendant of the group was used
+    uint32_t        m_HistoryStart[g_PropertyPageSize];         // g_HistoryRecorded when the property was published
+    uint8_t         m_SnapshotUsed[2][g_PropertyPageSize];
+    uint8_t         m_Published[g_PropertyPageSize];            // In the property tree, set when the tree is rebuilt
+    uint8_t         m_Type[g_PropertyPageSize];                 // ProfilePropertyType
+    Property        m_Properties[g_PropertyPageSize];
+    double*         m_History;  // g_HistoryFrameCount rows with one value per property, if the history is enabled
+    GroupRollup*    m_Rollups;  // One per property, if the roll-ups are enabled
+    WindowStats*    m_Windows;  // One per property, if the windows are enabled
+};
+
+static dmMutex::HMutex              g_Lock = 0;
+static int32_atomic_t               g_ProfileInitialized = 0;
+static int32_atomic_t               g_PropertyInitialized = 0;
+static uint32_t                     g_MaxPropertyCount = g_MaxPropertyPageCount * g_PropertyPageSize; // profiler_counter.max_properties
+static std::atomic<PropertyPage*>   g_PropertyPages[g_PropertyPageCount];
+static std::atomic<uint32_t>        g_PropertyCount(0); // One past the highest registered engine index
+static std::atomic<uint32_t>        g_ExtensionPropertyCount(0);
+static std::atomic<uint32_t>        g_PropertyGeneration(0);
+static dmHashTable32<ProfileIdx>    g_PropertyNameIndex;    // Name hash -> first property registered with that name
+static dmHashTable32<ProfileIdx>    g_PropertyPathIndex;    // Path hash -> property
+
+// The property tree flattened in pre-order, rebuilt at the end of the frame after properties are registered
+static const uint32_t               g_InvalidTreePosition = 0xFFFFFFFF;
+static dmArray<PropertyTreeNode>    g_PropertyTree;
+static dmArray<ProfileIdx>          g_PropertyTreeStack;
+static uint32_t                     g_PropertyTreeGeneration = 0;
+
+// Properties written during the frame. Pushed lock free by the writers, and drained in FrameEnd
+static std::atomic<ProfileIdx>      g_DirtyHead(PROFILE_PROPERTY_INVALID_IDX);
+
+// The published frame snapshot (front), and the properties that changed in each snapshot buffer when it was published
+static uint32_t                     g_SnapshotFront = 0;
+static uint32_t                     g_SnapshotFrame = 0;
+static dmArray<ProfileIdx>          g_SnapshotChanged[2];
+
+// Optional history of the last N frames for each property (profiler_counter.history_frames)
+static uint32_t         g_HistoryFrameCount = 0;
+static uint32_t         g_HistoryFrame = 0;     // The slot that is written next frame
+static uint32_t         g_HistorySize = 0;      // Number of recorded frames, up to g_HistoryFrameCount
+static uint32_t         g_HistoryRecorded = 0;  // Number of recorded frames since startup, never reset
+static double*          g_HistoryScratch = 0;   // Used for sorting when calculating the percentiles
+
+// The properties with add stats enabled
+static dmArray<ProfileIdx>  g_AddStatsProperties;
+
+// Optional group roll-ups (profiler_counter.group_rollups)
+static bool             g_RollupsEnabled = false;
+static uint32_t         g_RollupGeneration = 0;
+
+// Optional windowed aggregation (profiler_counter.window_frames / profiler_counter.window_ms)
+static uint32_t             g_WindowFrameCount = 0;     // Close the window after this many frames, 0 = no limit
+static uint32_t             g_WindowDuration = 0;       // Close the window after this many milliseconds, 0 = no limit
+static uint32_t             g_WindowIndex = 1;          // The window being accumulated
+static uint32_t             g_WindowFrame = 0;          // Frames in the current window so far
+static uint64_t             g_WindowStartTime = 0;
+static uint32_t             g_WindowGeneration = 0;
+static PropertyWindowInfo   g_WindowInfo;               // The last closed window
+
+// Capture file that is started together with the profiler (profiler_counter.capture_path)
+static const char*      g_CapturePath = 0;
+
+// Shared memory export (profiler_counter.shm_name)
+static const char*      g_ShmName = 0;
+static uint32_t         g_ShmCapacity = 4096;
+
+// Ring buffer for the LogText markers (profiler_counter.log_entries)
+static uint32_t         g_LogTextCapacity = 1024;
+
+// Http server (profiler_counter.http_port)
+static const char*      g_HttpAddress = "127.0.0.1";
+static uint32_t         g_HttpPort = 0;
 
 
 static bool IsProfileInitialized()
@@ -54,6 +239,34 @@ static bool IsProfileInitialized()
     if (!IsProfileInitialized()) \
         return;
 
+#if defined(PROFILER_SELF_STATS)
+// Counts the acquisitions of the lock, and the time spent waiting when another thread holds it
+struct SelfStatsScopedLock
+{
+    dmMutex::HMutex m_Mutex;
+
+    SelfStatsScopedLock(dmMutex::HMutex mutex) : m_Mutex(mutex)
+    {
+        uint64_t wait_time = 0;
+        if (!dmMutex::TryLock(mutex))
+        {
+            uint64_t start = dmTime::GetTime();
+            dmMutex::Lock(mutex);
+            wait_time = dmTime::GetTime() - start;
+        }
+        SelfStatsCountLock(wait_time);
+    }
+
+    ~SelfStatsScopedLock()
+    {
+        dmMutex::Unlock(m_Mutex);
+    }
+};
+#define PROPERTY_SCOPED_LOCK() SelfStatsScopedLock self_stats_lock(g_Lock)
+#else
+#define PROPERTY_SCOPED_LOCK() DM_MUTEX_SCOPED_LOCK(g_Lock)
+#endif
+
 // ****************************************************************************
 // Properties
 
@@ -62,370 +275,1726 @@ static inline bool IsValidIndex(ProfileIdx idx)
     return idx != PROFILE_PROPERTY_INVALID_IDX;
 }
 
+static inline PropertyPage* GetPropertyPage(ProfileIdx idx)
+{
+    if (idx >= g_MaxPropertyCount && (idx < g_ExtensionPropertyFirst || idx - g_ExtensionPropertyFirst >= g_ExtensionPropertyMax))
+        return 0;
+    return g_PropertyPages[idx >> g_PropertyPageShift].load(std::memory_order_acquire);
+}
+
+// Called with the lock held
+static PropertyPage* AllocatePropertyPage(uint32_t page_index)
+{
+    PropertyPage* page = g_PropertyPages[page_index].load(std::memory_order_relaxed);
+    if (page)
+        return page;
+
+    // All zeroes is a valid state for the property data.
+    // The pages are never freed, so we don't need to keep the unaligned pointer
+    uintptr_t memory = (uintptr_t)calloc(1, sizeof(PropertyPage) + g_CacheLineSize - 1);
+    page = (PropertyPage*)((memory + g_CacheLineSize - 1) & ~(uintptr_t)(g_CacheLineSize - 1));
+    if (g_HistoryFrameCount)
+        page->m_History = (double*)calloc(g_PropertyPageSize * g_HistoryFrameCount, sizeof(double));
+    if (g_RollupsEnabled)
+        page->m_Rollups = (GroupRollup*)calloc(g_PropertyPageSize, sizeof(GroupRollup));
+    if (g_WindowFrameCount || g_WindowDuration)
+        page->m_Windows = (WindowStats*)calloc(g_PropertyPageSize, sizeof(WindowStats));
+
+    g_PropertyPages[page_index].store(page, std::memory_order_release);
+    return page;
+}
+
+// Called with the lock held. Returns 0 if a property is already registered at the index,
+// since registering it again would link it into the tree twice
+static Property* AllocatePropertySlot(ProfileIdx idx)
+{
+    PropertyPage* page = AllocatePropertyPage(idx >> g_PropertyPageShift);
+    Property* prop = &page->m_Properties[idx & g_PropertyPageMask];
+    if (prop->m_Name)
+        return 0;
+
+    g_PropertyGeneration.fetch_add(1, std::memory_order_release);
+    return prop;
+}
+
+// An engine property. Called with the lock held
 static Property* AllocateProperty(ProfileIdx idx)
 {
-    DM_MUTEX_SCOPED_LOCK(g_Lock);
     if (idx >= g_MaxPropertyCount)
+    {
+        dmLogWarning("Max number of properties (%u) reached, property with index %u is ignored. Increase profiler_counter.max_properties in game.project", g_MaxPropertyCount, idx);
+        SELF_STATS(SelfStatsCountDropped());
         return 0;
-    return &g_Properties[idx];
+    }
+
+    Property* prop = AllocatePropertySlot(idx);
+    if (prop && idx >= g_PropertyCount.load(std::memory_order_relaxed))
+        g_PropertyCount.store(idx + 1, std::memory_order_release);
+    return prop;
 }
 
 static Property* GetPropertyFromIdx(ProfileIdx idx)
 {
     if (!IsValidIndex(idx))
         return 0;
-    DM_MUTEX_SCOPED_LOCK(g_Lock);
-    return &g_Properties[idx];
+    PropertyPage* page = GetPropertyPage(idx);
+    if (!page)
+        return 0;
+    return &page->m_Properties[idx & g_PropertyPageMask];
+}
+
+static PropertyData* GetPropertyDataFromIdx(ProfileIdx idx)
+{
+    if (!IsValidIndex(idx))
+        return 0;
+    PropertyPage* page = GetPropertyPage(idx);
+    if (!page)
+        return 0;
+    return &page->m_Data[idx & g_PropertyPageMask];
+}
+
+
+#define ALLOC_PROP_AND_CHECK(IDX)                       \
+    PropertyInitialize();                               \
+    PROPERTY_SCOPED_LOCK();                       \
+    Property* prop = AllocateProperty(IDX);             \
+    if (!prop)                                          \
+        return;
+
+// No lock is taken here, the writes to the property data are atomic.
+// The engine passes its listener context, and may only write its own indices. The extension writes its own properties
+// through the same functions (see PropertySetNumber), without a context
+#define GET_PROPDATA_AND_CHECK(CTX, IDX)                \
+    if (!IsProfileInitialized())                        \
+        return;                                         \
+    if ((CTX) && (IDX) >= g_MaxPropertyCount)           \
+        return;                                         \
+    PropertyData* data = GetPropertyDataFromIdx(IDX);   \
+    if (!data)                                          \
+        return;
+
+// ****************************************************************************
+// Atomic value slots
+//
+// NOTE: The 32 bit adds are done on the full 64 bit slot, so a negative or wrapping add carries into the upper half.
+// The upper half is masked off whenever the slot is read (see MaskValueBits), so the published bits are only the value.
+//
+// The writes use sequentially consistent ordering, and are done before checking the used flag.
+// Otherwise a write could slip in between FrameEnd clearing the flag and reading the value,
+// and the property would not be published again until the next time it was written.
+
+static inline uint64_t ValueToBits(ProfilePropertyValue value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline ProfilePropertyValue BitsToValue(uint64_t bits)
+{
+    ProfilePropertyValue value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Clears the carry that the 32 bit adds leave in the upper half of the slot
+static inline uint64_t MaskValueBits(ProfilePropertyType type, uint64_t bits)
+{
+    if (type == PROFILE_PROPERTY_TYPE_S32 || type == PROFILE_PROPERTY_TYPE_U32)
+        return bits & 0xFFFFFFFF;
+    return bits;
+}
+
+static inline ProfilePropertyValue LoadValue(const PropertyData* data, ProfilePropertyType type)
+{
+    return BitsToValue(MaskValueBits(type, data->m_Value.load()));
+}
+
+static inline void StoreValue(PropertyData* data, ProfilePropertyValue value)
+{
+    data->m_Value.store(ValueToBits(value));
+}
+
+static inline void AddValueBits(std::atomic<uint64_t>& slot, uint64_t bits)
+{
+    slot.fetch_add(bits);
+}
+
+static inline void AddValueF32(std::atomic<uint64_t>& slot, float v)
+{
+    uint64_t bits = slot.load(std::memory_order_relaxed);
+    ProfilePropertyValue value;
+    do
+    {
+        value = BitsToValue(bits);
+        value.m_F32 += v;
+    } while (!slot.compare_exchange_weak(bits, ValueToBits(value)));
+}
+
+static inline void AddValueF64(std::atomic<uint64_t>& slot, double v)
+{
+    uint64_t bits = slot.load(std::memory_order_relaxed);
+    ProfilePropertyValue value;
+    do
+    {
+        value = BitsToValue(bits);
+        value.m_F64 += v;
+    } while (!slot.compare_exchange_weak(bits, ValueToBits(value)));
+}
+
+// The slot an Add goes to. With per thread values, it's the thread's own slot, which is added to the value in FrameEnd
+static inline std::atomic<uint64_t>& GetAddSlot(PropertyData* data)
+{
+    ThreadValues* values = data->m_ThreadValues.load(std::memory_order_acquire);
+    if (!values)
+        return data->m_Value;
+
+    ThreadValue* thread = &values->m_Threads[ThreadsGetIndex()];
+    if (!(thread->m_Used.load(std::memory_order_relaxed) & THREAD_VALUE_ADDED))
+        thread->m_Used.fetch_or(THREAD_VALUE_ADDED);
+    return thread->m_Add;
+}
+
+static inline void RecordThreadSet(PropertyData* data, ProfilePropertyValue value)
+{
+    ThreadValues* values = data->m_ThreadValues.load(std::memory_order_acquire);
+    if (!values)
+        return;
+
+    ThreadValue* thread = &values->m_Threads[ThreadsGetIndex()];
+    thread->m_Set.store(ValueToBits(value), std::memory_order_relaxed);
+    if (!(thread->m_Used.load(std::memory_order_relaxed) & THREAD_VALUE_SET))
+        thread->m_Used.fetch_or(THREAD_VALUE_SET);
+}
+
+static inline void PushDirty(ProfileIdx idx, PropertyData* data)
+{
+    ProfileIdx head = g_DirtyHead.load(std::memory_order_relaxed);
+    do
+    {
+        data->m_NextDirty.store(head, std::memory_order_relaxed);
+    } while (!g_DirtyHead.compare_exchange_weak(head, idx, std::memory_order_release, std::memory_order_relaxed));
+}
+
+static inline void SetUsage(ProfileIdx idx, PropertyData* data, PropertyUsage usage)
+{
+    if (data->m_Used.exchange(usage) == PROPERTY_UNUSED)
+        PushDirty(idx, data);
+}
+
+// Most writes happen to already used properties, so we avoid the exchange if we can
+static inline void MarkUsed(ProfileIdx idx, PropertyData* data)
+{
+    if (data->m_Used.load() != PROPERTY_USED)
+        SetUsage(idx, data, PROPERTY_USED);
+}
+
+// Bucket i counts the increments where 2^i <= |v| < 2^(i+1). Bucket 0 also counts the ones below 1
+static inline uint32_t GetAddStatsBucket(double v)
+{
+    double magnitude = v < 0.0 ? -v : v;
+    if (magnitude < 2.0)
+        return 0;
+    uint64_t u = magnitude >= 4294967296.0 ? 0xFFFFFFFF : (uint64_t)magnitude;
+    uint32_t bucket = 0;
+    for (uint32_t shift = 16; shift > 0; shift >>= 1)
+    {
+        if (u >> shift)
+        {
+            u >>= shift;
+            bucket += shift;
+        }
+    }
+    return bucket < PROPERTY_ADD_STATS_BUCKETS ? bucket : PROPERTY_ADD_STATS_BUCKETS - 1;
+}
+
+static inline void UpdateAddStatsLimit(std::atomic<uint64_t>& limit, double v, bool is_min)
+{
+    uint64_t bits = limit.load(std::memory_order_relaxed);
+    while (true)
+    {
+        double current;
+        memcpy(&current, &bits, sizeof(current));
+        if (is_min ? !(v < current) : !(v > current))
+            return;
+        uint64_t new_bits;
+        memcpy(&new_bits, &v, sizeof(new_bits));
+        if (limit.compare_exchange_weak(bits, new_bits, std::memory_order_relaxed))
+            return;
+    }
+}
+
+static void ResetAddStatsLimits(AddStats* stats)
+{
+    double min = HUGE_VAL;
+    double max = -HUGE_VAL;
+    uint64_t bits;
+    memcpy(&bits, &min, sizeof(bits));
+    stats->m_Min.store(bits, std::memory_order_relaxed);
+    memcpy(&bits, &max, sizeof(bits));
+    stats->m_Max.store(bits, std::memory_order_relaxed);
+}
+
+static inline void RecordAdd(PropertyData* data, double v)
+{
+    AddStats* stats = data->m_AddStats.load(std::memory_order_acquire);
+    if (!stats)
+        return;
+    stats->m_Count.fetch_add(1, std::memory_order_relaxed);
+    stats->m_Buckets[GetAddStatsBucket(v)].fetch_add(1, std::memory_order_relaxed);
+    UpdateAddStatsLimit(stats->m_Min, v, true);
+    UpdateAddStatsLimit(stats->m_Max, v, false);
+}
+
+#define SET_PROPDATA_VALUE(FIELD, V)                    \
+    ProfilePropertyValue value;                         \
+    value.m_U64 = 0;                                    \
+    value.FIELD = V;                                    \
+    StoreValue(data, value);                            \
+    RecordThreadSet(data, value);                       \
+    MarkUsed(idx, data);                                \
+    SELF_STATS(SelfStatsCountSet());
+
+static inline bool IsFrameReset(uint32_t flags)
+{
+    return (flags & PROFILE_PROPERTY_FRAME_RESET) == PROFILE_PROPERTY_FRAME_RESET;
+}
+
+// Called with the lock held
+static void InitializePropertyData(ProfileIdx idx, ProfilePropertyType type, uint32_t flags, ProfilePropertyValue default_value)
+{
+    PropertyPage* page = GetPropertyPage(idx);
+    uint32_t i = idx & g_PropertyPageMask;
+    uint64_t bits = ValueToBits(default_value);
+    uint8_t used = type == PROFILE_PROPERTY_TYPE_GROUP ? 1 : 0; // used == 0, means we won't traverse it during display
+
+    page->m_Type[i]             = (uint8_t)type;
+    page->m_Flags[i]            = flags;
+    page->m_DefaultValue[i]     = bits;
+    page->m_Snapshot[0][i]      = bits;
+    page->m_Snapshot[1][i]      = bits;
+    page->m_SnapshotUsed[0][i]  = used;
+    page->m_SnapshotUsed[1][i]  = used;
+    page->m_Data[i].m_Value.store(bits);
+}
+
+// Invoked when first property is initialized
+static void PropertyInitialize()
+{
+    if (dmAtomicIncrement32(&g_PropertyInitialized) != 0)
+        return;
+
+    g_Lock = dmMutex::New();
+
+    Property* root = AllocateProperty(0);
+    root->m_Name = "Root";
+    root->m_NameHash = dmHashString32(root->m_Name);
+    root->m_Parent = PROFILE_PROPERTY_INVALID_IDX;
+    root->m_FirstChild = PROFILE_PROPERTY_INVALID_IDX;
+    root->m_LastChild = PROFILE_PROPERTY_INVALID_IDX;
+    root->m_Sibling = PROFILE_PROPERTY_INVALID_IDX;
+    root->m_TreePosition = g_InvalidTreePosition;
+
+    ProfilePropertyValue zero;
+    zero.m_U64 = 0;
+    InitializePropertyData(0, PROFILE_PROPERTY_TYPE_GROUP, 0, zero);
+
+    g_SnapshotChanged[0].SetCapacity(64);
+    g_SnapshotChanged[1].SetCapacity(64);
+}
+
+static double ValueToDouble(ProfilePropertyType type, ProfilePropertyValue value)
+{
+    switch (type)
+    {
+        case PROFILE_PROPERTY_TYPE_BOOL:    return value.m_Bool ? 1.0 : 0.0;
+        case PROFILE_PROPERTY_TYPE_S32:     return (double)value.m_S32;
+        case PROFILE_PROPERTY_TYPE_U32:     return (double)value.m_U32;
+        case PROFILE_PROPERTY_TYPE_F32:     return (double)value.m_F32;
+        case PROFILE_PROPERTY_TYPE_S64:     return (double)value.m_S64;
+        case PROFILE_PROPERTY_TYPE_U64:     return (double)value.m_U64;
+        case PROFILE_PROPERTY_TYPE_F64:     return value.m_F64;
+        default:                            return 0.0;
+    }
+}
+
+static inline void AddChanged(dmArray<ProfileIdx>& changed, ProfileIdx idx, PropertyPage* page, uint32_t i)
+{
+    if (page->m_ChangedFrame[i] == g_SnapshotFrame)
+        return;
+    page->m_ChangedFrame[i] = g_SnapshotFrame;
+    if (changed.Full())
+        changed.OffsetCapacity(changed.Capacity() + 64);
+    changed.Push(idx);
+}
+
+// Adds the Add calls of each thread to the value (after any Set during the frame), and publishes the per thread values.
+// Called with the lock held, after the property was taken off the dirty list, so a concurrent Add ends up in the next frame.
+static void MergeThreadValues(PropertyData* data, ThreadValues* values, ProfilePropertyType type)
+{
+    values->m_PublishedFrame = g_SnapshotFrame;
+    values->m_PublishedCount = 0;
+
+    uint32_t count = ThreadsGetCount();
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ThreadValue* thread = &values->m_Threads[i];
+        uint32_t used = thread->m_Used.exchange(0);
+        uint64_t add = thread->m_Add.exchange(0);
+        if (!used && !add)
+            continue;
+
+        double value = 0.0;
+        if (used & THREAD_VALUE_SET)
+            value = ValueToDouble(type, BitsToValue(thread->m_Set.load(std::memory_order_relaxed)));
+
+        ProfilePropertyValue delta = BitsToValue(add);
+        if (type == PROFILE_PROPERTY_TYPE_F32)
+            AddValueF32(data->m_Value, delta.m_F32);
+        else if (type == PROFILE_PROPERTY_TYPE_F64)
+            AddValueF64(data->m_Value, delta.m_F64);
+        else
+            AddValueBits(data->m_Value, add);
+        value += ValueToDouble(type, delta);
+
+        values->m_PublishedThreads[values->m_PublishedCount] = i;
+        values->m_PublishedValues[values->m_PublishedCount] = value;
+        values->m_PublishedCount++;
+    }
+}
+
+// Publishes the frame by writing the changes into the back buffer, and then swapping the snapshot buffers.
+// The cost is proportional to the number of properties that were touched this frame and the last.
+// Called with the lock held.
+static void ResetProperties()
+{
+    uint32_t front = g_SnapshotFront;
+    uint32_t back = 1 - front;
+    dmArray<ProfileIdx>& changed = g_SnapshotChanged[back];
+    changed.SetSize(0);
+    g_SnapshotFrame++;
+
+    // The back buffer only differs from the front buffer in the properties that changed last frame.
+    // Unless they are written again, those are now unused, and the frame reset ones are back to their default value.
+    const dmArray<ProfileIdx>& front_changed = g_SnapshotChanged[front];
+    for (uint32_t i = 0; i < front_changed.Size(); ++i)
+    {
+        ProfileIdx idx = front_changed[i];
+        PropertyPage* page = GetPropertyPage(idx);
+        uint32_t slot = idx & g_PropertyPageMask;
+
+        uint64_t bits = IsFrameReset(page->m_Flags[slot]) ? page->m_DefaultValue[slot] : page->m_Snapshot[front][slot];
+        page->m_Snapshot[back][slot] = bits;
+        page->m_SnapshotUsed[back][slot] = 0;
+
+        if (page->m_SnapshotUsed[front][slot] || bits != page->m_Snapshot[front][slot])
+            AddChanged(changed, idx, page, slot);
+    }
+
+    // For easy access in the script, as the script function may be run before the properties we want to get
+    // and they may be currently 0 (i.e. reset on each frame end)
+    // The exchanges make sure that a concurrent write ends up in either this frame or the next, never lost.
+    ProfileIdx idx = g_DirtyHead.exchange(PROFILE_PROPERTY_INVALID_IDX, std::memory_order_acquire);
+    while (IsValidIndex(idx))
+    {
+        PropertyPage* page = GetPropertyPage(idx);
+        uint32_t slot = idx & g_PropertyPageMask;
+        PropertyData* data = &page->m_Data[slot];
+
+        // Read the link before clearing the flag, after that the property may be pushed again
+        ProfileIdx next = data->m_NextDirty.load(std::memory_order_relaxed);
+        uint32_t usage = data->m_Used.exchange(PROPERTY_UNUSED);
+
+        ThreadValues* thread_values = data->m_ThreadValues.load(std::memory_order_acquire);
+        if (thread_values)
+            MergeThreadValues(data, thread_values, (ProfilePropertyType)page->m_Type[slot]);
+
+        uint64_t bits;
+        if (IsFrameReset(page->m_Flags[slot]))
+            bits = data->m_Value.exchange(page->m_DefaultValue[slot]);
+        else
+            bits = data->m_Value.load();
+        bits = MaskValueBits((ProfilePropertyType)page->m_Type[slot], bits);
+
+        page->m_Snapshot[back][slot] = bits;
+        page->m_SnapshotUsed[back][slot] = usage == PROPERTY_USED ? 1 : 0;
+        AddChanged(changed, idx, page, slot);
+
+        idx = next;
+    }
+
+    g_SnapshotFront = back;
+}
+
+// The number of slots on the page that may hold a property: the engine's are below g_PropertyCount,
+// and the extension's are the first g_ExtensionPropertyCount from g_ExtensionPropertyFirst
+static uint32_t GetPageSlotCount(uint32_t page_index)
+{
+    uint32_t first = page_index << g_PropertyPageShift;
+    uint32_t end = first < g_ExtensionPropertyFirst
+                    ? g_PropertyCount.load(std::memory_order_acquire)
+                    : g_ExtensionPropertyFirst + g_ExtensionPropertyCount.load(std::memory_order_acquire);
+    if (end <= first)
+        return 0;
+    return end - first < g_PropertyPageSize ? end - first : g_PropertyPageSize;
+}
+
+// The history is a pass over all properties, so it's only done when it's enabled.
+// Called after the frame is published.
+static void RecordHistory()
+{
+    if (!g_HistoryScratch)
+        return;
+
+    uint32_t front = g_SnapshotFront;
+    for (uint32_t page_index = 0; page_index < g_PropertyPageCount; ++page_index)
+    {
+        PropertyPage* page = g_PropertyPages[page_index].load(std::memory_order_acquire);
+        if (!page || !page->m_History)
+            continue;
+
+        uint32_t page_count = GetPageSlotCount(page_index);
+
+        // Linear over the columns, and the row for this frame
+        const uint8_t* published = page->m_Published;
+        const uint8_t* types = page->m_Type;
+        const uint64_t* snapshot = page->m_Snapshot[front];
+        double* row = &page->m_History[g_HistoryFrame * g_PropertyPageSize];
+        for (uint32_t i = 0; i < page_count; ++i)
+        {
+            row[i] = published[i] ? ValueToDouble((ProfilePropertyType)types[i], BitsToValue(snapshot[i])) : 0.0;
+        }
+    }
+
+    g_HistoryFrame = (g_HistoryFrame + 1) % g_HistoryFrameCount;
+    if (g_HistorySize < g_HistoryFrameCount)
+        g_HistorySize++;
+    g_HistoryRecorded++;
+}
+
+// ****************************************************************************
+// Windows
+
+// Adds the value held since m_Since, up to (not including) the frame
+static inline void AccumulateWindow(WindowStats* window, uint32_t frame)
+{
+    if (frame == window->m_Since)
+        return; // Replaced in the same frame, so it never was a frame value
+    window->m_Sum += window->m_Value * (frame - window->m_Since);
+    if (window->m_Value > window->m_Max)
+        window->m_Max = window->m_Value;
+    window->m_Since = frame;
+}
+
+static void StartWindow(WindowStats* window, double value, uint32_t frame)
+{
+    window->m_Sum       = 0.0;
+    window->m_Max       = -HUGE_VAL;
+    window->m_Value     = value;
+    window->m_Since     = frame;
+    window->m_Start     = frame;
+    window->m_Window    = g_WindowIndex;
+}
+
+static inline double GetFrontValue(PropertyPage* page, uint32_t slot)
+{
+    return ValueToDouble((ProfilePropertyType)page->m_Type[slot], BitsToValue(page->m_Snapshot[g_SnapshotFront][slot]));
+}
+
+// A new property starts from the frame it was first seen in
+static void StartNewWindow(PropertyPage* page, uint32_t slot, WindowStats* window, uint32_t frame)
+{
+    if (window->m_Window != g_WindowIndex)
+        StartWindow(window, GetFrontValue(page, slot), frame);
+}
+
+static void CloseWindow(PropertyPage* page, uint32_t slot, WindowStats* window, uint32_t frame)
+{
+    if (window->m_Window != g_WindowIndex)
+        return;
+
+    AccumulateWindow(window, frame);
+    window->m_Published.m_Sum       = window->m_Sum;
+    window->m_Published.m_Average   = window->m_Sum / (frame - window->m_Start);
+    window->m_Published.m_Max       = window->m_Max;
+    window->m_PublishedWindow       = g_WindowIndex;
+}
+
+typedef void (*WindowFn)(PropertyPage* page, uint32_t slot, WindowStats* window, uint32_t frame);
+
+// Calls fn for the properties (not groups) that have window stats
+static void ForEachWindow(WindowFn fn, uint32_t frame)
+{
+    for (uint32_t page_index = 0; page_index < g_PropertyPageCount; ++page_index)
+    {
+        PropertyPage* page = g_PropertyPages[page_index].load(std::memory_order_acquire);
+        if (!page || !page->m_Windows)
+            continue;
+
+        uint32_t page_count = GetPageSlotCount(page_index);
+
+        for (uint32_t i = 0; i < page_count; ++i)
+        {
+            if (page->m_Published[i] && page->m_Type[i] != PROFILE_PROPERTY_TYPE_GROUP)
+                fn(page, i, &page->m_Windows[i], frame);
+        }
+    }
+}
+
+// Only the properties that changed are touched each frame, and all of them when the window closes.
+// Called after the frame is published.
+static void UpdateWindow()
+{
+    if (!g_WindowFrameCount && !g_WindowDuration)
+        return;
+
+    uint32_t frame = g_WindowFrame;
+    uint64_t time = dmTime::GetTime();
+    if (frame == 0)
+        g_WindowStartTime = time;
+
+    if (g_PropertyTreeGeneration != g_WindowGeneration)
+    {
+        g_WindowGeneration = g_PropertyTreeGeneration;
+        ForEachWindow(StartNewWindow, frame);
+    }
+
+    const dmArray<ProfileIdx>& changed = g_SnapshotChanged[g_SnapshotFront];
+    for (uint32_t i = 0; i < changed.Size(); ++i)
+    {
+        ProfileIdx idx = changed[i];
+        PropertyPage* page = GetPropertyPage(idx);
+        uint32_t slot = idx & g_PropertyPageMask;
+        if (!page->m_Windows || page->m_Windows[slot].m_Window != g_WindowIndex)
+            continue;
+
+        WindowStats* window = &page->m_Windows[slot];
+        double value = GetFrontValue(page, slot);
+        AccumulateWindow(window, frame);
+        window->m_Value = value;
+    }
+
+    g_WindowFrame = ++frame;
+    bool closed = (g_WindowFrameCount && frame >= g_WindowFrameCount)
+               || (g_WindowDuration && time - g_WindowStartTime >= (uint64_t)g_WindowDuration * 1000);
+    if (!closed)
+        return;
+
+    ForEachWindow(CloseWindow, frame);
+    g_WindowInfo.m_Index        = g_WindowIndex;
+    g_WindowInfo.m_FrameCount   = frame;
+    g_WindowInfo.m_Duration     = time - g_WindowStartTime;
+
+    // The next window starts with the values the properties have now
+    g_WindowIndex++;
+    g_WindowFrame = 0;
+    ForEachWindow(StartNewWindow, 0);
+}
+
+// ****************************************************************************
+// Property tree
+
+// Flattens the tree in pre-order, so that the children of a property follow it, and a subtree is a range of the array.
+// Only done when properties were registered since the last time.
+// Called with the lock held, at the end of the frame, so the iterators always see the same tree during a frame.
+static void UpdatePropertyTree()
+{
+    uint32_t generation = g_PropertyGeneration.load(std::memory_order_acquire);
+    if (generation == g_PropertyTreeGeneration && !g_PropertyTree.Empty())
+        return;
+    g_PropertyTreeGeneration = generation;
+
+    // Properties registered since the last time don't have a position yet
+    for (uint32_t i = 0; i < g_PropertyTree.Size(); ++i)
+        GetPropertyFromIdx(g_PropertyTree[i].m_Property)->m_TreePosition = g_InvalidTreePosition;
+
+    uint32_t count = g_PropertyCount.load(std::memory_order_acquire) + g_ExtensionPropertyCount.load(std::memory_order_acquire);
+    if (g_PropertyTree.Capacity() < count)
+        g_PropertyTree.SetCapacity(count);
+    if (g_PropertyTreeStack.Capacity() < count)
+        g_PropertyTreeStack.SetCapacity(count);
+    g_PropertyTree.SetSize(0);
+    g_PropertyTreeStack.SetSize(0);
+
+    // The stack holds the open groups. A group is closed when the next property isn't one of its descendants,
+    // and its size is then the number of nodes added since its own.
+    ProfileIdx idx = 0;
+    while (true)
+    {
+        Property* prop = GetPropertyFromIdx(idx);
+        prop->m_TreePosition = g_PropertyTree.Size();
+
+        PropertyPage* page = GetPropertyPage(idx);
+        uint32_t slot = idx & g_PropertyPageMask;
+        if (!page->m_Published[slot])
+        {
+            page->m_Published[slot] = 1;
+            page->m_HistoryStart[slot] = g_HistoryRecorded;
+        }
+
+        PropertyTreeNode node;
+        node.m_Property = idx;
+        node.m_Depth    = g_PropertyTreeStack.Size();
+        node.m_Size     = 1;
+        g_PropertyTree.Push(node);
+
+        if (IsValidIndex(prop->m_FirstChild))
+        {
+            g_PropertyTreeStack.Push(idx);
+            idx = prop->m_FirstChild;
+            continue;
+        }
+
+        // Close the groups until one of them has a next sibling
+        while (!IsValidIndex(prop->m_Sibling) && !g_PropertyTreeStack.Empty())
+        {
+            ProfileIdx group = g_PropertyTreeStack.Back();
+            g_PropertyTreeStack.Pop();
+            prop = GetPropertyFromIdx(group);
+            g_PropertyTree[prop->m_TreePosition].m_Size = g_PropertyTree.Size() - prop->m_TreePosition;
+        }
+        if (g_PropertyTreeStack.Empty())
+            break; // Back at the root, which has no siblings
+        idx = prop->m_Sibling;
+    }
+}
+
+// ****************************************************************************
+// Used subtrees
+
+// Marks the ancestors of the properties that were used in the published frame, so that the iterator
+// can skip a group without any used descendants in one check, instead of visiting all of them.
+// A property is only used if it was written, so they are all in the changed list.
+// Called after the frame is published.
+static void MarkUsedSubtrees()
+{
+    uint32_t front = g_SnapshotFront;
+    const dmArray<ProfileIdx>& changed = g_SnapshotChanged[front];
+    for (uint32_t i = 0; i < changed.Size(); ++i)
+    {
+        ProfileIdx idx = changed[i];
+        if (!GetPropertyPage(idx)->m_SnapshotUsed[front][idx & g_PropertyPageMask])
+            continue;
+
+        ProfileIdx parent = GetPropertyFromIdx(idx)->m_Parent;
+        Property* prop;
+        while ((prop = GetPropertyFromIdx(parent)) != 0)
+        {
+            uint32_t* used_frame = &GetPropertyPage(parent)->m_SubtreeUsedFrame[parent & g_PropertyPageMask];
+            if (*used_frame == g_SnapshotFrame)
+                break; // The rest of the ancestors are already marked
+            *used_frame = g_SnapshotFrame;
+            parent = prop->m_Parent;
+        }
+    }
+}
+
+static inline bool IsUsedInFrame(PropertyPage* page, uint32_t slot)
+{
+    if (!page->m_SnapshotUsed[g_SnapshotFront][slot])
+        return false;
+    return page->m_Type[slot] != PROFILE_PROPERTY_TYPE_GROUP || page->m_SubtreeUsedFrame[slot] == g_SnapshotFrame;
+}
+
+// ****************************************************************************
+// Add stats
+
+// Moves the stats of the frame into the published copy. Called with the lock held
+static void PublishAddStats()
+{
+    for (uint32_t i = 0; i < g_AddStatsProperties.Size(); ++i)
+    {
+        AddStats* stats = GetPropertyDataFromIdx(g_AddStatsProperties[i])->m_AddStats.load(std::memory_order_relaxed);
+        PropertyAddStats* published = &stats->m_Published;
+
+        published->m_Count = stats->m_Count.exchange(0, std::memory_order_relaxed);
+        for (uint32_t b = 0; b < PROPERTY_ADD_STATS_BUCKETS; ++b)
+            published->m_Buckets[b] = stats->m_Buckets[b].exchange(0, std::memory_order_relaxed);
+
+        uint64_t min = stats->m_Min.load(std::memory_order_relaxed);
+        uint64_t max = stats->m_Max.load(std::memory_order_relaxed);
+        ResetAddStatsLimits(stats);
+        memcpy(&published->m_Min, &min, sizeof(min));
+        memcpy(&published->m_Max, &max, sizeof(max));
+        if (!published->m_Count)
+        {
+            published->m_Min = 0.0;
+            published->m_Max = 0.0;
+        }
+    }
+}
+
+// ****************************************************************************
+// Group roll-ups
+
+static inline void AddToRollup(PropertyRollup* rollup, double sum, double max, uint32_t count)
+{
+    if (!count)
+        return;
+    rollup->m_Max = rollup->m_Count ? (max > rollup->m_Max ? max : rollup->m_Max) : max;
+    rollup->m_Sum += sum;
+    rollup->m_Count += count;
+}
+
+// Recalculates the roll-up from the direct children, after updating the child groups that changed.
+// The children are found in the published tree, since the child links may be updated by a registration.
+static void UpdateGroupRollup(uint32_t position, bool all)
+{
+    PropertyRollup rollup;
+    memset(&rollup, 0, sizeof(rollup));
+
+    uint32_t front = g_SnapshotFront;
+    const PropertyTreeNode* nodes = g_PropertyTree.Begin();
+    uint32_t end = position + nodes[position].m_Size;
+    for (uint32_t child = position + 1; child < end; child += nodes[child].m_Size)
+    {
+        ProfileIdx idx = nodes[child].m_Property;
+        PropertyPage* page = GetPropertyPage(idx);
+        uint32_t slot = idx & g_PropertyPageMask;
+        ProfilePropertyType type = (ProfilePropertyType)page->m_Type[slot];
+
+        if (type == PROFILE_PROPERTY_TYPE_GROUP)
+        {
+            GroupRollup* child_rollup = &page->m_Rollups[slot];
+            if (all || child_rollup->m_DirtyFrame == g_SnapshotFrame)
+                UpdateGroupRollup(child, all);
+            AddToRollup(&rollup, child_rollup->m_Rollup.m_Sum, child_rollup->m_Rollup.m_Max, child_rollup->m_Rollup.m_Count);
+        }
+        else if (type != PROFILE_PROPERTY_TYPE_BOOL)
+        {
+            double value = ValueToDouble(type, BitsToValue(page->m_Snapshot[front][slot]));
+            AddToRollup(&rollup, value, value, 1);
+        }
+    }
+
+    ProfileIdx group = nodes[position].m_Property;
+    GetPropertyPage(group)->m_Rollups[group & g_PropertyPageMask].m_Rollup = rollup;
+}
+
+// Marks the ancestors of the properties that changed this frame, and updates only those groups.
+// Called after the frame is published.
+static void UpdateRollups()
+{
+    if (!g_RollupsEnabled)
+        return;
+
+    // A new property changes the counts, so everything is updated
+    if (g_PropertyTreeGeneration != g_RollupGeneration)
+    {
+        g_RollupGeneration = g_PropertyTreeGeneration;
+        UpdateGroupRollup(0, true);
+        return;
+    }
+
+    const dmArray<ProfileIdx>& changed = g_SnapshotChanged[g_SnapshotFront];
+    if (changed.Empty())
+        return;
+
+    for (uint32_t i = 0; i < changed.Size(); ++i)
+    {
+        ProfileIdx parent = GetPropertyFromIdx(changed[i])->m_Parent;
+        Property* prop;
+        while ((prop = GetPropertyFromIdx(parent)) != 0)
+        {
+            GroupRollup* rollup = &GetPropertyPage(parent)->m_Rollups[parent & g_PropertyPageMask];
+            if (rollup->m_DirtyFrame == g_SnapshotFrame)
+                break; // The rest of the ancestors are already marked
+            rollup->m_DirtyFrame = g_SnapshotFrame;
+            parent = prop->m_Parent;
+        }
+    }
+
+    UpdateGroupRollup(0, false);
+}
+
+// ****************************************************************************
+// History
+
+static void HistoryInitialize()
+{
+    g_HistoryFrame = 0;
+    g_HistorySize = 0;
+    if (!g_HistoryFrameCount)
+        return;
+
+    // The history rings are allocated together with the property pages
+    g_HistoryScratch = (double*)calloc(g_HistoryFrameCount, sizeof(double));
+}
+
+static void HistoryFinalize()
+{
+    free(g_HistoryScratch);
+    g_HistoryScratch = 0;
+}
+
+static int CompareDouble(const void* a, const void* b)
+{
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+// A property registered during the window only has the frames recorded since then
+static inline uint32_t GetHistoryCount(const PropertyPage* page, uint32_t slot)
+{
+    if (!page->m_Published[slot])
+        return 0;
+    uint32_t recorded = g_HistoryRecorded - page->m_HistoryStart[slot];
+    return recorded < g_HistorySize ? recorded : g_HistorySize;
+}
+
+// Nearest rank percentile of a sorted array
+static double GetPercentile(const double* sorted, uint32_t count, uint32_t percent)
+{
+    uint32_t rank = (percent * count + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// The path excludes the root, e.g. "Physics/Contacts"
+static uint32_t CalcPathHash(ProfileIdx idx)
+{
+    const char* names[32];
+    uint32_t num_names = 0;
+    Property* prop = GetPropertyFromIdx(idx);
+    while (prop && prop->m_Parent != PROFILE_PROPERTY_INVALID_IDX && num_names < 32)
+    {
+        names[num_names++] = prop->m_Name;
+        prop = GetPropertyFromIdx(prop->m_Parent);
+    }
+
+    char path[512];
+    path[0] = 0;
+    for (uint32_t i = num_names; i > 0; --i)
+    {
+        if (i != num_names)
+            dmStrlCat(path, "/", sizeof(path));
+        dmStrlCat(path, names[i - 1], sizeof(path));
+    }
+    return dmHashString32(path);
+}
+
+// Called with the lock held
+static void AddToIndex(dmHashTable32<ProfileIdx>& index, uint32_t hash, ProfileIdx idx, bool replace)
+{
+    if (!replace && index.Get(hash))
+        return;
+    if (index.Full())
+    {
+        uint32_t capacity = index.Capacity() + 256;
+        index.SetCapacity(capacity / 2 + 1, capacity);
+    }
+    index.Put(hash, idx);
+}
+
+static const char* StripNamePrefix(const char* name)
+{
+    if (name[0]=='r' && name[1]=='m' && name[2]=='t' && name[3]=='p' && name[4]=='_')
+    {
+        name = name + 5;
+    }
+    return name;
+}
+
+// The name is used as is, the prefix is stripped by the caller
+static void SetupProperty(Property* prop, ProfileIdx idx, const char* name, const char* desc, ProfileIdx parentidx)
+{
+    memset(prop, 0, sizeof(Property));
+    prop->m_Name         = name;
+    prop->m_NameHash     = dmHashString32(name);
+    prop->m_Description  = desc;
+    prop->m_FirstChild   = PROFILE_PROPERTY_INVALID_IDX;
+    prop->m_LastChild    = PROFILE_PROPERTY_INVALID_IDX;
+    prop->m_Sibling      = PROFILE_PROPERTY_INVALID_IDX;
+    prop->m_Parent       = parentidx;
+    prop->m_TreePosition = g_InvalidTreePosition;
+
+    // Appended last, so that they'll render in the same order they were registered
+    Property* parent = GetPropertyFromIdx(prop->m_Parent);
+    if (parent)
+    {
+        if (IsValidIndex(parent->m_LastChild))
+            GetPropertyFromIdx(parent->m_LastChild)->m_Sibling = idx;
+        else
+            parent->m_FirstChild = idx;
+        parent->m_LastChild = idx;
+    }
+    if (prop->m_Parent == 0)
+    {
+        assert(idx != 0);
+    }
+
+    prop->m_PathHash = CalcPathHash(idx);
+    AddToIndex(g_PropertyNameIndex, prop->m_NameHash, idx, false);
+    AddToIndex(g_PropertyPathIndex, prop->m_PathHash, idx, true);
+}
+
+static void ProfileCreatePropertyGroup(void*, const char* name, const char* desc, ProfileIdx idx, ProfileIdx parent)
+{
+    ALLOC_PROP_AND_CHECK(idx);
+    SetupProperty(prop, idx, StripNamePrefix(name), desc, parent);
+    ProfilePropertyValue default_value;
+    default_value.m_U64 = 0;
+    InitializePropertyData(idx, PROFILE_PROPERTY_TYPE_GROUP, 0, default_value);
+}
+
+static void ProfileCreatePropertyBool(void*, const char* name, const char* desc, int value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+{
+    ALLOC_PROP_AND_CHECK(idx);
+    SetupProperty(prop, idx, StripNamePrefix(name), desc, parent);
+    ProfilePropertyValue default_value;
+    default_value.m_U64 = 0;
+    default_value.m_Bool = (bool)value;
+    InitializePropertyData(idx, PROFILE_PROPERTY_TYPE_BOOL, flags, default_value);
+}
+
+static void ProfileCreatePropertyS32(void*, const char* name, const char* desc, int32_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+{
+    ALLOC_PROP_AND_CHECK(idx);
+    SetupProperty(prop, idx, StripNamePrefix(name), desc, parent);
+    ProfilePropertyValue default_value;
+    default_value.m_U64 = 0;
+    default_value.m_S32 = value;
+    InitializePropertyData(idx, PROFILE_PROPERTY_TYPE_S32, flags, default_value);
+}
+
+static void ProfileCreatePropertyU32(void*, const char* name, const char* desc, uint32_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+{
+    ALLOC_PROP_AND_CHECK(idx);
+    SetupProperty(prop, idx, StripNamePrefix(name), desc, parent);
+    ProfilePropertyValue default_value;
+    default_value.m_U64 = 0;
+    default_value.m_U32 = value;
+    InitializePropertyData(idx, PROFILE_PROPERTY_TYPE_U32, flags, default_value);
+}
+
+static void ProfileCreatePropertyF32(void*, const char* name, const char* desc, float value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+{
+    ALLOC_PROP_AND_CHECK(idx);
+    SetupProperty(prop, idx, StripNamePrefix(name), desc, parent);
+    ProfilePropertyValue default_value;
+    default_value.m_U64 = 0;
+    default_value.m_F32 = value;
+    InitializePropertyData(idx, PROFILE_PROPERTY_TYPE_F32, flags, default_value);
+}
+
+static void ProfileCreatePropertyS64(void*, const char* name, const char* desc, int64_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+{
+    ALLOC_PROP_AND_CHECK(idx);
+    SetupProperty(prop, idx, StripNamePrefix(name), desc, parent);
+    ProfilePropertyValue default_value;
+    default_value.m_U64 = 0;
+    default_value.m_S64 = value;
+    InitializePropertyData(idx, PROFILE_PROPERTY_TYPE_S64, flags, default_value);
+}
+
+static void ProfileCreatePropertyU64(void*, const char* name, const char* desc, uint64_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+{
+    ALLOC_PROP_AND_CHECK(idx);
+    SetupProperty(prop, idx, StripNamePrefix(name), desc, parent);
+    ProfilePropertyValue default_value;
+    default_value.m_U64 = 0;
+    default_value.m_U64 = value;
+    InitializePropertyData(idx, PROFILE_PROPERTY_TYPE_U64, flags, default_value);
+}
+
+static void ProfileCreatePropertyF64(void*, const char* name, const char* desc, double value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+{
+    ALLOC_PROP_AND_CHECK(idx);
+    SetupProperty(prop, idx, StripNamePrefix(name), desc, parent);
+    ProfilePropertyValue default_value;
+    default_value.m_U64 = 0;
+    default_value.m_F64 = value;
+    InitializePropertyData(idx, PROFILE_PROPERTY_TYPE_F64, flags, default_value);
+}
+
+static void ProfilePropertySetBool(void* ctx, ProfileIdx idx, int v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SET_PROPDATA_VALUE(m_Bool, v);
+}
+
+static void ProfilePropertySetS32(void* ctx, ProfileIdx idx, int32_t v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SET_PROPDATA_VALUE(m_S32, v);
+}
+
+static void ProfilePropertySetU32(void* ctx, ProfileIdx idx, uint32_t v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SET_PROPDATA_VALUE(m_U32, v);
+}
+
+static void ProfilePropertySetF32(void* ctx, ProfileIdx idx, float v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SET_PROPDATA_VALUE(m_F32, v);
+}
+
+static void ProfilePropertySetS64(void* ctx, ProfileIdx idx, int64_t v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SET_PROPDATA_VALUE(m_S64, v);
+}
+
+static void ProfilePropertySetU64(void* ctx, ProfileIdx idx, uint64_t v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SET_PROPDATA_VALUE(m_U64, v);
+}
+
+static void ProfilePropertySetF64(void* ctx, ProfileIdx idx, double v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SET_PROPDATA_VALUE(m_F64, v);
+}
+
+static void ProfilePropertyAddS32(void* ctx, ProfileIdx idx, int32_t v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SELF_STATS(SelfStatsCountAdd());
+    AddValueBits(GetAddSlot(data), (uint64_t)(uint32_t)v);
+    RecordAdd(data, (double)v);
+    MarkUsed(idx, data);
+}
+
+static void ProfilePropertyAddU32(void* ctx, ProfileIdx idx, uint32_t v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SELF_STATS(SelfStatsCountAdd());
+    AddValueBits(GetAddSlot(data), (uint64_t)v);
+    RecordAdd(data, (double)v);
+    MarkUsed(idx, data);
+}
+
+static void ProfilePropertyAddF32(void* ctx, ProfileIdx idx, float v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SELF_STATS(SelfStatsCountAdd());
+    AddValueF32(GetAddSlot(data), v);
+    RecordAdd(data, (double)v);
+    MarkUsed(idx, data);
+}
+
+static void ProfilePropertyAddS64(void* ctx, ProfileIdx idx, int64_t v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SELF_STATS(SelfStatsCountAdd());
+    AddValueBits(GetAddSlot(data), (uint64_t)v);
+    RecordAdd(data, (double)v);
+    MarkUsed(idx, data);
+}
+
+static void ProfilePropertyAddU64(void* ctx, ProfileIdx idx, uint64_t v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SELF_STATS(SelfStatsCountAdd());
+    AddValueBits(GetAddSlot(data), v);
+    RecordAdd(data, (double)v);
+    MarkUsed(idx, data);
+}
+
+static void ProfilePropertyAddF64(void* ctx, ProfileIdx idx, double v)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    SELF_STATS(SelfStatsCountAdd());
+    AddValueF64(GetAddSlot(data), v);
+    RecordAdd(data, v);
+    MarkUsed(idx, data);
+}
+
+static void ProfilePropertyReset(void* ctx, ProfileIdx idx)
+{
+    GET_PROPDATA_AND_CHECK(ctx, idx);
+    PropertyPage* page = GetPropertyPage(idx);
+    data->m_Value.store(page->m_DefaultValue[idx & g_PropertyPageMask]);
+
+    // The pending adds and sets from the threads are dropped too
+    ThreadValues* values = data->m_ThreadValues.load(std::memory_order_acquire);
+    if (values)
+    {
+        for (uint32_t i = 0; i < THREADS_SLOT_COUNT; ++i)
+        {
+            ThreadValue* thread = &values->m_Threads[i];
+            thread->m_Add.store(0);
+            thread->m_Set.store(0);
+            thread->m_Used.store(0);
+        }
+    }
+    SetUsage(idx, data, PROPERTY_RESET);
+}
+
+// ****************************************************************************
+// Properties owned by the extension
+
+// The extension properties are numbered from g_ExtensionPropertyFirst, in the order they are created
+HProperty PropertyCreate(const char* name, const char* desc, ProfilePropertyType type, uint32_t flags, HProperty parent)
+{
+    if (type > PROFILE_PROPERTY_TYPE_GROUP)
+        return PROFILE_PROPERTY_INVALID_IDX;
+
+    PropertyInitialize();
+    PROPERTY_SCOPED_LOCK();
+    uint32_t count = g_ExtensionPropertyCount.load(std::memory_order_relaxed);
+    if (count >= g_ExtensionPropertyMax)
+    {
+        dmLogWarning("Max number of extension properties (%u) reached, '%s' is ignored", g_ExtensionPropertyMax, name);
+        SELF_STATS(SelfStatsCountDropped());
+        return PROFILE_PROPERTY_INVALID_IDX;
+    }
+
+    ProfileIdx idx = g_ExtensionPropertyFirst + count;
+    Property* prop = AllocatePropertySlot(idx);
+    g_ExtensionPropertyCount.store(count + 1, std::memory_order_release);
+
+    // The property owns the copies, they are freed in PropertyFinalize
+    SetupProperty(prop, idx, strdup(StripNamePrefix(name)), strdup(desc ? desc : ""), parent);
+    ProfilePropertyValue default_value;
+    default_value.m_U64 = 0;
+    InitializePropertyData(idx, type, flags, default_value);
+    return idx;
+}
+
+static void UnlinkProperty(ProfileIdx idx, Property* prop)
+{
+    Property* parent = GetPropertyFromIdx(prop->m_Parent);
+    if (!parent)
+        return;
+
+    ProfileIdx prev = PROFILE_PROPERTY_INVALID_IDX;
+    ProfileIdx child = parent->m_FirstChild;
+    while (IsValidIndex(child) && child != idx)
+    {
+        prev = child;
+        child = GetPropertyFromIdx(child)->m_Sibling;
+    }
+    if (child != idx)
+        return;
+
+    if (IsValidIndex(prev))
+        GetPropertyFromIdx(prev)->m_Sibling = prop->m_Sibling;
+    else
+        parent->m_FirstChild = prop->m_Sibling;
+    if (parent->m_LastChild == idx)
+        parent->m_LastChild = prev;
+}
+
+// Unregisters the extension properties and frees their names, the engine properties stay registered.
+// Called when the listener is destroyed, before the lock is deleted
+static void PropertyFinalize()
+{
+    if (!g_Lock)
+        return;
+
+    PROPERTY_SCOPED_LOCK();
+    uint32_t count = g_ExtensionPropertyCount.load(std::memory_order_relaxed);
+    if (!count)
+        return;
+
+    // Newest first, so a group is unlinked after its children. An engine group may have extension properties as children
+    for (uint32_t i = count; i > 0; --i)
+    {
+        ProfileIdx idx = g_ExtensionPropertyFirst + i - 1;
+        Property* prop = GetPropertyFromIdx(idx);
+        if (!prop->m_Name)
+            continue;
+
+        UnlinkProperty(idx, prop);
+        free((void*)prop->m_Name);
+        free((void*)prop->m_Description);
+        memset(prop, 0, sizeof(Property));
+        GetPropertyPage(idx)->m_Published[idx & g_PropertyPageMask] = 0;
+
+        // Like the pages, the stats are never freed, since a writer may still hold them
+        PropertyData* data = GetPropertyDataFromIdx(idx);
+        data->m_AddStats.store(0, std::memory_order_relaxed);
+        data->m_ThreadValues.store(0, std::memory_order_relaxed);
+    }
+
+    uint32_t num_add_stats = 0;
+    for (uint32_t i = 0; i < g_AddStatsProperties.Size(); ++i)
+    {
+        if (g_AddStatsProperties[i] < g_ExtensionPropertyFirst)
+            g_AddStatsProperties[num_add_stats++] = g_AddStatsProperties[i];
+    }
+    g_AddStatsProperties.SetSize(num_add_stats);
+
+    // An extension property may have been the first one with its name, so the indices are rebuilt from the engine properties
+    g_PropertyNameIndex.Clear();
+    g_PropertyPathIndex.Clear();
+    uint32_t engine_count = g_PropertyCount.load(std::memory_order_relaxed);
+    for (ProfileIdx idx = 1; idx < engine_count; ++idx)
+    {
+        Property* prop = GetPropertyFromIdx(idx);
+        if (!prop || !prop->m_Name)
+            continue;
+        AddToIndex(g_PropertyNameIndex, prop->m_NameHash, idx, false);
+        AddToIndex(g_PropertyPathIndex, prop->m_PathHash, idx, true);
+    }
+
+    g_ExtensionPropertyCount.store(0, std::memory_order_release);
+    g_PropertyGeneration.fetch_add(1, std::memory_order_release);
 }
 
-static PropertyData* GetPropertyDataFromIdx(ProfileIdx idx)
+// Writes straight into the published frame, so it's visible in the same frame it was calculated
+void PropertySetFrameValue(HProperty hproperty, ProfilePropertyValue value)
 {
-    if (!IsValidIndex(idx))
-        return 0;
-    return &g_PropertyData[idx];
-}
+    ProfileIdx idx = (ProfileIdx)hproperty;
+    PropertyPage* page = GetPropertyPage(idx);
+    if (!page)
+        return;
 
+    uint32_t slot = idx & g_PropertyPageMask;
+    uint32_t front = g_SnapshotFront;
+    uint64_t bits = ValueToBits(value);
+    page->m_Data[slot].m_Value.store(bits);
+    page->m_Snapshot[front][slot] = bits;
+    page->m_SnapshotUsed[front][slot] = 1;
+    AddChanged(g_SnapshotChanged[front], idx, page, slot);
+}
 
-#define ALLOC_PROP_AND_CHECK(IDX)                       \
-    PropertyInitialize();                               \
-    Property* prop = AllocateProperty(IDX);             \
-    if (!prop)                                          \
+// Same as the DM_PROPERTY_SET_* macros, with the value converted to the property type
+void PropertySetNumber(HProperty hproperty, double value)
+{
+    ProfileIdx idx = (ProfileIdx)hproperty;
+    PropertyPage* page = GetPropertyPage(idx);
+    if (!page)
         return;
 
-#define GET_PROPDATA_AND_CHECK(IDX)                     \
-    if (!IsProfileInitialized())                        \
-        return;                                         \
-    DM_MUTEX_SCOPED_LOCK(g_Lock);                       \
-    PropertyData* data = GetPropertyDataFromIdx(IDX);   \
-    if (!data)                                          \
-        return;
+    switch ((ProfilePropertyType)page->m_Type[idx & g_PropertyPageMask])
+    {
+        case PROFILE_PROPERTY_TYPE_BOOL:    ProfilePropertySetBool(0, idx, value != 0.0); break;
+        case PROFILE_PROPERTY_TYPE_S32:     ProfilePropertySetS32(0, idx, (int32_t)value); break;
+        case PROFILE_PROPERTY_TYPE_U32:     ProfilePropertySetU32(0, idx, (uint32_t)value); break;
+        case PROFILE_PROPERTY_TYPE_F32:     ProfilePropertySetF32(0, idx, (float)value); break;
+        case PROFILE_PROPERTY_TYPE_S64:     ProfilePropertySetS64(0, idx, (int64_t)value); break;
+        case PROFILE_PROPERTY_TYPE_U64:     ProfilePropertySetU64(0, idx, (uint64_t)value); break;
+        case PROFILE_PROPERTY_TYPE_F64:     ProfilePropertySetF64(0, idx, value); break;
+        default:                            break;
+    }
+}
 
-// Invoked when first property is initialized
-static void PropertyInitialize()
+// Same as the DM_PROPERTY_ADD_* macros, with the value converted to the property type
+void PropertyAddNumber(HProperty hproperty, double value)
 {
-    if (dmAtomicIncrement32(&g_PropertyInitialized) != 0)
+    ProfileIdx idx = (ProfileIdx)hproperty;
+    PropertyPage* page = GetPropertyPage(idx);
+    if (!page)
         return;
 
-    memset(g_Properties, 0, sizeof(g_Properties));
-    memset(g_PropertyData, 0, sizeof(g_PropertyData));
+    switch ((ProfilePropertyType)page->m_Type[idx & g_PropertyPageMask])
+    {
+        case PROFILE_PROPERTY_TYPE_S32:     ProfilePropertyAddS32(0, idx, (int32_t)value); break;
+        case PROFILE_PROPERTY_TYPE_U32:     ProfilePropertyAddU32(0, idx, (uint32_t)value); break;
+        case PROFILE_PROPERTY_TYPE_F32:     ProfilePropertyAddF32(0, idx, (float)value); break;
+        case PROFILE_PROPERTY_TYPE_S64:     ProfilePropertyAddS64(0, idx, (int64_t)value); break;
+        case PROFILE_PROPERTY_TYPE_U64:     ProfilePropertyAddU64(0, idx, (uint64_t)value); break;
+        case PROFILE_PROPERTY_TYPE_F64:     ProfilePropertyAddF64(0, idx, value); break;
+        default:                            break;
+    }
+}
+
+// Iterators
 
-    g_Lock = dmMutex::New();
 
-    g_Properties[0].m_Name = "Root";
-    g_Properties[0].m_NameHash = dmHashString32(g_Properties[0].m_Name);
-    g_Properties[0].m_Type = PROFILE_PROPERTY_TYPE_GROUP;
-    g_Properties[0].m_Parent = PROFILE_PROPERTY_INVALID_IDX;
-    g_Properties[0].m_FirstChild = PROFILE_PROPERTY_INVALID_IDX;
-    g_Properties[0].m_Sibling = PROFILE_PROPERTY_INVALID_IDX;
-    g_PropertyData[0].m_Used = 1; // used == 0, means we won't traverse it during display
+PropertyIterator::PropertyIterator()
+    : m_Property(0)
+    , m_IteratorImpl(0)
+    , m_End(0)
+    , m_AllProperties(false)
+{
 }
 
-static void ResetProperties()
+PropertyIterator::~PropertyIterator()
 {
-    for (uint32_t i = 0; i < g_MaxPropertyCount; ++i)
-    {
-        Property* prop = &g_Properties[i];
-        PropertyData* data = &g_PropertyData[i];
+}
 
-        // For easy access in the script, as the script function may be run before the properties we want to get
-        // and they may be currently 0 (i.e. reset on each frame end)
-        data->m_PrevValue = data->m_Value;
-        data->m_PrevUsed = data->m_Used;
+#define CHECK_HPROPERTY(HPROP)                          \
+    ProfileIdx      idx  = (ProfileIdx)HPROP;           \
+    PropertyPage*   page = GetPropertyPage(idx);        \
+    uint32_t        slot = idx & g_PropertyPageMask;    \
+    PropertyData*   data = GetPropertyDataFromIdx(idx); \
+    Property*       prop = GetPropertyFromIdx(idx);     \
+    (void)page; (void)slot; (void)data; (void)prop;
 
-        data->m_Used = prop->m_Type == PROFILE_PROPERTY_TYPE_GROUP ? 1 : 0;
+PropertyIterator* PropertyIterateChildren(HProperty hproperty, bool all_properties, PropertyIterator* iter)
+{
+    CHECK_HPROPERTY(hproperty);
+    iter->m_AllProperties = all_properties;
+    iter->m_Property = 0;
+    iter->m_IteratorImpl = 0;
+    iter->m_End = 0;
 
-        if ((prop->m_Flags & PROFILE_PROPERTY_FRAME_RESET) == PROFILE_PROPERTY_FRAME_RESET)
-        {
-            data->m_Value = prop->m_DefaultValue;
-        }
+    // The children are the range after the property in the tree. Properties registered this frame aren't in it yet
+    uint32_t position = prop->m_TreePosition;
+    if (position < g_PropertyTree.Size())
+    {
+        iter->m_IteratorImpl = (void*)(uintptr_t)(position + 1);
+        iter->m_End = position + g_PropertyTree[position].m_Size;
     }
+    return iter;
 }
 
-static void SetupProperty(Property* prop, ProfileIdx idx, const char* name, const char* desc, uint32_t flags, ProfileIdx parentidx)
+bool PropertyIterateNext(PropertyIterator* iter)
 {
-    if (name[0]=='r' && name[1]=='m' && name[2]=='t' && name[3]=='p' && name[4]=='_')
+    uint32_t position = (uint32_t)(uintptr_t)iter->m_IteratorImpl;
+    while (position < iter->m_End)
     {
-        name = name + 5;
-    }
-
-    memset(prop, 0, sizeof(Property));
-    prop->m_Flags        = flags;
-    prop->m_Name         = name;
-    prop->m_NameHash     = dmHashString32(name);
-    prop->m_Description  = desc;
-    prop->m_FirstChild   = PROFILE_PROPERTY_INVALID_IDX;
-    prop->m_Sibling      = PROFILE_PROPERTY_INVALID_IDX;
-    prop->m_Parent       = parentidx;
+        // The next sibling follows the subtree of this one
+        const PropertyTreeNode& node = g_PropertyTree[position];
+        position += node.m_Size;
 
-    // TODO: append them last so that they'll render in the same order they were registered
-    Property* parent = GetPropertyFromIdx(prop->m_Parent);
-    if (parent)
-    {
-        prop->m_Sibling = parent->m_FirstChild;
-        parent->m_FirstChild = idx;
-    }
-    if (prop->m_Parent == 0)
-    {
-        assert(idx != 0);
+        // let's skip the non used ones, and the groups without any used descendants
+        ProfileIdx idx = node.m_Property;
+        if (iter->m_AllProperties || IsUsedInFrame(GetPropertyPage(idx), idx & g_PropertyPageMask))
+        {
+            iter->m_Property = (HProperty)idx;
+            iter->m_IteratorImpl = (void*)(uintptr_t)position;
+            return true;
+        }
     }
+    iter->m_IteratorImpl = (void*)(uintptr_t)position;
+    return false;
 }
 
-static void ProfileCreatePropertyGroup(void*, const char* name, const char* desc, ProfileIdx idx, ProfileIdx parent)
+uint32_t PropertyGetTree(const PropertyTreeNode** nodes)
 {
-    ALLOC_PROP_AND_CHECK(idx);
-    SetupProperty(prop, idx, name, desc, 0, parent);
-    prop->m_Type = PROFILE_PROPERTY_TYPE_GROUP;
+    *nodes = g_PropertyTree.Begin();
+    return g_PropertyTree.Size();
 }
 
-static void ProfileCreatePropertyBool(void*, const char* name, const char* desc, int value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+uint32_t PropertyGetTreeGeneration()
 {
-    ALLOC_PROP_AND_CHECK(idx);
-    SetupProperty(prop, idx, name, desc, flags, parent);
-    prop->m_DefaultValue.m_Bool = (bool)value;
-    prop->m_Type = PROFILE_PROPERTY_TYPE_BOOL;
+    return g_PropertyTreeGeneration;
 }
 
-static void ProfileCreatePropertyS32(void*, const char* name, const char* desc, int32_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+uint32_t PropertyGetTreePosition(HProperty hproperty)
 {
-    ALLOC_PROP_AND_CHECK(idx);
-    SetupProperty(prop, idx, name, desc, flags, parent);
-    prop->m_DefaultValue.m_S32 = value;
-    prop->m_Type = PROFILE_PROPERTY_TYPE_S32;
+    CHECK_HPROPERTY(hproperty);
+    return prop->m_TreePosition < g_PropertyTree.Size() ? prop->m_TreePosition : g_PropertyTree.Size();
 }
 
-static void ProfileCreatePropertyU32(void*, const char* name, const char* desc, uint32_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+// Property accessors
+
+uint32_t PropertyGetNameHash(HProperty hproperty)
 {
-    ALLOC_PROP_AND_CHECK(idx);
-    SetupProperty(prop, idx, name, desc, flags, parent);
-    prop->m_DefaultValue.m_U32 = value;
-    prop->m_Type = PROFILE_PROPERTY_TYPE_U32;
+    CHECK_HPROPERTY(hproperty)
+    return prop->m_NameHash;
 }
 
-static void ProfileCreatePropertyF32(void*, const char* name, const char* desc, float value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+const char* PropertyGetName(HProperty hproperty)
 {
-    ALLOC_PROP_AND_CHECK(idx);
-    SetupProperty(prop, idx, name, desc, flags, parent);
-    prop->m_DefaultValue.m_F32 = value;
-    prop->m_Type = PROFILE_PROPERTY_TYPE_F32;
+    CHECK_HPROPERTY(hproperty)
+    return prop->m_Name;
 }
 
-static void ProfileCreatePropertyS64(void*, const char* name, const char* desc, int64_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+void PropertyGetPath(HProperty hproperty, char* path, uint32_t path_length)
 {
-    ALLOC_PROP_AND_CHECK(idx);
-    SetupProperty(prop, idx, name, desc, flags, parent);
-    prop->m_DefaultValue.m_S64 = value;
-    prop->m_Type = PROFILE_PROPERTY_TYPE_S64;
+    static const uint32_t max_depth = 32;
+    ProfileIdx chain[max_depth];
+    uint32_t depth = 0;
+    for (ProfileIdx idx = hproperty; idx != 0 && depth < max_depth; )
+    {
+        Property* prop = GetPropertyFromIdx(idx);
+        if (!prop)
+            break;
+        chain[depth++] = idx;
+        idx = prop->m_Parent;
+    }
+
+    path[0] = 0;
+    while (depth--)
+    {
+        if (path[0])
+            dmStrlCat(path, "/", path_length);
+        dmStrlCat(path, GetPropertyFromIdx(chain[depth])->m_Name, path_length);
+    }
 }
 
-static void ProfileCreatePropertyU64(void*, const char* name, const char* desc, uint64_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+const char* PropertyGetDesc(HProperty hproperty)
 {
-    ALLOC_PROP_AND_CHECK(idx);
-    SetupProperty(prop, idx, name, desc, flags, parent);
-    prop->m_DefaultValue.m_U64 = value;
-    prop->m_Type = PROFILE_PROPERTY_TYPE_U64;
+    CHECK_HPROPERTY(hproperty)
+    return prop->m_Description;
 }
 
-static void ProfileCreatePropertyF64(void*, const char* name, const char* desc, double value, uint32_t flags, ProfileIdx idx, ProfileIdx parent)
+ProfilePropertyType PropertyGetType(HProperty hproperty)
 {
-    ALLOC_PROP_AND_CHECK(idx);
-    SetupProperty(prop, idx, name, desc, flags, parent);
-    prop->m_DefaultValue.m_F64 = value;
-    prop->m_Type = PROFILE_PROPERTY_TYPE_F64;
+    CHECK_HPROPERTY(hproperty)
+    return (ProfilePropertyType)page->m_Type[slot];
 }
 
-static void ProfilePropertySetBool(void*, ProfileIdx idx, int v)
+ProfilePropertyValue PropertyGetValue(HProperty hproperty)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_Bool = v;
-    data->m_Used = 1;
+    CHECK_HPROPERTY(hproperty)
+    return LoadValue(data, (ProfilePropertyType)page->m_Type[slot]);
 }
 
-static void ProfilePropertySetS32(void*, ProfileIdx idx, int32_t v)
+ProfilePropertyValue PropertyGetPrevValue(HProperty hproperty)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_S32 = v;
-    data->m_Used = 1;
+    CHECK_HPROPERTY(hproperty)
+    return BitsToValue(page->m_Snapshot[g_SnapshotFront][slot]);
 }
 
-static void ProfilePropertySetU32(void*, ProfileIdx idx, uint32_t v)
+double PropertyGetPrevNumber(HProperty hproperty)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_U32 = v;
-    data->m_Used = 1;
+    CHECK_HPROPERTY(hproperty)
+    if (!prop)
+        return 0.0;
+    return ValueToDouble((ProfilePropertyType)page->m_Type[slot], BitsToValue(page->m_Snapshot[g_SnapshotFront][slot]));
 }
 
-static void ProfilePropertySetF32(void*, ProfileIdx idx, float v)
+bool PropertyGetHistoryStats(HProperty hproperty, PropertyHistoryStats* stats)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_F32 = v;
-    data->m_Used = 1;
+    if (!g_HistoryScratch || !g_HistorySize)
+        return false;
+
+    CHECK_HPROPERTY(hproperty)
+    if (!prop || !page->m_History || page->m_Type[slot] == PROFILE_PROPERTY_TYPE_GROUP)
+        return false;
+
+    uint32_t count = GetHistoryCount(page, slot);
+    if (!count)
+        return false;
+
+    // Only the most recent rows, the older ones are from before the property was registered
+    uint32_t frame = g_HistoryFrame + g_HistoryFrameCount - count;
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        double value = page->m_History[((frame + i) % g_HistoryFrameCount) * g_PropertyPageSize + slot];
+        g_HistoryScratch[i] = value;
+        sum += value;
+    }
+    qsort(g_HistoryScratch, count, sizeof(double), CompareDouble);
+
+    stats->m_Count  = count;
+    stats->m_Min    = g_HistoryScratch[0];
+    stats->m_Max    = g_HistoryScratch[count - 1];
+    stats->m_Mean   = sum / count;
+    stats->m_P95    = GetPercentile(g_HistoryScratch, count, 95);
+    stats->m_P99    = GetPercentile(g_HistoryScratch, count, 99);
+    return true;
 }
 
-static void ProfilePropertySetS64(void*, ProfileIdx idx, int64_t v)
+uint32_t PropertyGetHistorySize()
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_S64 = v;
-    data->m_Used = 1;
+    return g_HistoryScratch ? g_HistorySize : 0;
 }
 
-static void ProfilePropertySetU64(void*, ProfileIdx idx, uint64_t v)
+uint32_t PropertyGetHistory(HProperty hproperty, double* values, uint32_t max_count)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_U64 = v;
-    data->m_Used = 1;
+    if (!g_HistoryScratch)
+        return 0;
+
+    CHECK_HPROPERTY(hproperty)
+    if (!prop || !page->m_History || page->m_Type[slot] == PROFILE_PROPERTY_TYPE_GROUP)
+        return 0;
+
+    uint32_t count = GetHistoryCount(page, slot);
+    if (count > max_count)
+        count = max_count;
+    uint32_t frame = g_HistoryFrame + g_HistoryFrameCount - count; // The oldest one we want
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        values[i] = page->m_History[((frame + i) % g_HistoryFrameCount) * g_PropertyPageSize + slot];
+    }
+    return count;
 }
 
-static void ProfilePropertySetF64(void*, ProfileIdx idx, double v)
+bool PropertyEnableAddStats(HProperty hproperty)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_F64 = v;
-    data->m_Used = 1;
+    if (!g_Lock)
+        return false;
+
+    PROPERTY_SCOPED_LOCK();
+    CHECK_HPROPERTY(hproperty)
+    if (!prop || !prop->m_Name || page->m_Type[slot] == PROFILE_PROPERTY_TYPE_GROUP || page->m_Type[slot] == PROFILE_PROPERTY_TYPE_BOOL)
+        return false;
+    if (data->m_AddStats.load(std::memory_order_relaxed))
+        return true;
+
+    // Like the pages, the stats are never freed
+    AddStats* stats = (AddStats*)calloc(1, sizeof(AddStats));
+    ResetAddStatsLimits(stats);
+
+    if (g_AddStatsProperties.Full())
+        g_AddStatsProperties.OffsetCapacity(16);
+    g_AddStatsProperties.Push(idx);
+    data->m_AddStats.store(stats, std::memory_order_release);
+    return true;
 }
 
-static void ProfilePropertyAddS32(void*, ProfileIdx idx, int32_t v)
+bool PropertyEnableThreadValues(HProperty hproperty)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_S32 += v;
-    data->m_Used = 1;
+    if (!g_Lock)
+        return false;
+
+    PROPERTY_SCOPED_LOCK();
+    CHECK_HPROPERTY(hproperty)
+    if (!prop || !prop->m_Name || page->m_Type[slot] == PROFILE_PROPERTY_TYPE_GROUP)
+        return false;
+    if (data->m_ThreadValues.load(std::memory_order_relaxed))
+        return true;
+
+    // Like the pages, they are never freed, so we don't need to keep the unaligned pointer
+    uintptr_t memory = (uintptr_t)calloc(1, sizeof(ThreadValues) + g_CacheLineSize - 1);
+    ThreadValues* values = (ThreadValues*)((memory + g_CacheLineSize - 1) & ~(uintptr_t)(g_CacheLineSize - 1));
+
+    // The adds that already went into the value this frame stay there
+    data->m_ThreadValues.store(values, std::memory_order_release);
+    return true;
 }
 
-static void ProfilePropertyAddU32(void*, ProfileIdx idx, uint32_t v)
+uint32_t PropertyGetThreadValues(HProperty hproperty, uint32_t* threads, double* values, uint32_t max_count)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_U32 += v;
-    data->m_Used = 1;
+    CHECK_HPROPERTY(hproperty)
+    ThreadValues* thread_values = data ? data->m_ThreadValues.load(std::memory_order_acquire) : 0;
+    if (!thread_values || thread_values->m_PublishedFrame != g_SnapshotFrame)
+        return 0;
+
+    uint32_t count = thread_values->m_PublishedCount < max_count ? thread_values->m_PublishedCount : max_count;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        threads[i] = thread_values->m_PublishedThreads[i];
+        values[i] = thread_values->m_PublishedValues[i];
+    }
+    return count;
 }
 
-static void ProfilePropertyAddF32(void*, ProfileIdx idx, float v)
+bool PropertyGetAddStats(HProperty hproperty, PropertyAddStats* stats)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_F32 += v;
-    data->m_Used = 1;
+    CHECK_HPROPERTY(hproperty)
+    AddStats* add_stats = data ? data->m_AddStats.load(std::memory_order_acquire) : 0;
+    if (!add_stats)
+        return false;
+    *stats = add_stats->m_Published;
+    return true;
 }
 
-static void ProfilePropertyAddS64(void*, ProfileIdx idx, int64_t v)
+bool PropertyGetWindowInfo(PropertyWindowInfo* info)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_S64 += v;
-    data->m_Used = 1;
+    if (!g_WindowInfo.m_Index)
+        return false;
+    *info = g_WindowInfo;
+    return true;
 }
 
-static void ProfilePropertyAddU64(void*, ProfileIdx idx, uint64_t v)
+bool PropertyGetWindowStats(HProperty hproperty, PropertyWindowStats* stats)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_U64 += v;
-    data->m_Used = 1;
+    if (!g_WindowInfo.m_Index)
+        return false;
+
+    CHECK_HPROPERTY(hproperty)
+    if (!prop || !page->m_Windows || page->m_Windows[slot].m_PublishedWindow != g_WindowInfo.m_Index)
+        return false;
+
+    *stats = page->m_Windows[slot].m_Published;
+    return true;
 }
 
-static void ProfilePropertyAddF64(void*, ProfileIdx idx, double v)
+bool PropertyGetRollup(HProperty hproperty, PropertyRollup* rollup)
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    data->m_Value.m_F64 += v;
-    data->m_Used = 1;
+    if (!g_RollupsEnabled)
+        return false;
+
+    CHECK_HPROPERTY(hproperty)
+    if (!prop || page->m_Type[slot] != PROFILE_PROPERTY_TYPE_GROUP)
+        return false;
+
+    *rollup = page->m_Rollups[slot].m_Rollup;
+    return true;
 }
 
-static void ProfilePropertyReset(void*, ProfileIdx idx)
+uint32_t PropertyGetGeneration()
 {
-    GET_PROPDATA_AND_CHECK(idx);
-    Property* prop = GetPropertyFromIdx(idx);
-    data->m_Value = prop->m_DefaultValue;
-    data->m_Used = 0;
+    return g_PropertyGeneration.load(std::memory_order_acquire);
 }
 
-// Iterators
-
-
-PropertyIterator::PropertyIterator()
-    : m_Property(0)
-    , m_IteratorImpl(0)
-    , m_AllProperties(false)
+uint32_t PropertyGetCount()
 {
+    return g_PropertyCount.load(std::memory_order_acquire);
 }
 
-PropertyIterator::~PropertyIterator()
+uint32_t PropertyGetExtensionFirst()
 {
+    return g_ExtensionPropertyFirst;
 }
 
-#define CHECK_HPROPERTY(HPROP)                          \
-    ProfileIdx      idx  = (ProfileIdx)HPROP;          \
-    PropertyData*   data = GetPropertyDataFromIdx(idx); \
-    Property*       prop = GetPropertyFromIdx(idx);     \
-    (void)data; (void)prop;
+uint32_t PropertyGetExtensionCount()
+{
+    return g_ExtensionPropertyCount.load(std::memory_order_acquire);
+}
 
-PropertyIterator* PropertyIterateChildren(HProperty hproperty, bool all_properties, PropertyIterator* iter)
+bool PropertyIsValid(HProperty hproperty)
 {
-    CHECK_HPROPERTY(hproperty);
-    iter->m_AllProperties = all_properties;
-    iter->m_Property = 0;
-    iter->m_IteratorImpl = (void*)(uintptr_t)prop->m_FirstChild;
-    return iter;
+    Property* prop = GetPropertyFromIdx(hproperty);
+    return prop && prop->m_Name;
 }
 
-bool PropertyIterateNext(PropertyIterator* iter)
+bool PropertyIsPublished(HProperty hproperty)
 {
-    ProfileIdx idx = (ProfileIdx)(uintptr_t)iter->m_IteratorImpl;
-    if (!IsValidIndex(idx))
-        return false;
+    PropertyPage* page = GetPropertyPage((ProfileIdx)hproperty);
+    return page && page->m_Published[hproperty & g_PropertyPageMask];
+}
 
-    PropertyData* data = GetPropertyDataFromIdx(idx);
+bool PropertyGetPrevUsed(HProperty hproperty)
+{
+    CHECK_HPROPERTY(hproperty)
+    return page->m_SnapshotUsed[g_SnapshotFront][slot] != 0;
+}
 
-    if (!iter->m_AllProperties)
-    {
-        // let's skip the non used ones
-        while (!data->m_PrevUsed)
-        {
-            Property* prop = GetPropertyFromIdx(idx);
-            idx = prop->m_Sibling;
-            if (!IsValidIndex(idx))
-            {
-                return false;
-            }
-            data = GetPropertyDataFromIdx(idx);
-        }
-    }
+HProperty PropertyFindByName(const char* name)
+{
+    return PropertyFindByNameHash(dmHashString32(name));
+}
 
-    Property* prop = GetPropertyFromIdx(idx);
-    iter->m_Property = (HProperty)idx;
-    iter->m_IteratorImpl = (void*)(uintptr_t)prop->m_Sibling;
-    return true;
+HProperty PropertyFindByNameHash(uint32_t name_hash)
+{
+    PROPERTY_SCOPED_LOCK();
+    ProfileIdx* idx = g_PropertyNameIndex.Get(name_hash);
+    return idx ? (HProperty)*idx : PROFILE_PROPERTY_INVALID_IDX;
 }
 
-// Property accessors
+HProperty PropertyFindByPath(const char* path)
+{
+    return PropertyFindByPathHash(dmHashString32(path));
+}
 
-uint32_t PropertyGetNameHash(HProperty hproperty)
+HProperty PropertyFindByPathHash(uint32_t path_hash)
 {
-    CHECK_HPROPERTY(hproperty)
-    return prop->m_NameHash;
+    PROPERTY_SCOPED_LOCK();
+    ProfileIdx* idx = g_PropertyPathIndex.Get(path_hash);
+    return idx ? (HProperty)*idx : PROFILE_PROPERTY_INVALID_IDX;
 }
 
-const char* PropertyGetName(HProperty hproperty)
+uint32_t PropertyGetPathHash(HProperty hproperty)
 {
     CHECK_HPROPERTY(hproperty)
-    return prop->m_Name;
+    return prop->m_PathHash;
 }
 
-const char* PropertyGetDesc(HProperty hproperty)
+HProperty PropertyGetParent(HProperty hproperty)
 {
     CHECK_HPROPERTY(hproperty)
-    return prop->m_Description;
+    return prop->m_Parent;
 }
 
-ProfilePropertyType PropertyGetType(HProperty hproperty)
+uint32_t PropertyGetFlags(HProperty hproperty)
 {
     CHECK_HPROPERTY(hproperty)
-    return prop->m_Type;
+    return page->m_Flags[slot];
 }
 
-ProfilePropertyValue PropertyGetValue(HProperty hproperty)
+uint32_t PropertyGetFrame()
 {
-    CHECK_HPROPERTY(hproperty)
-    return data->m_Value;
+    return g_SnapshotFrame;
 }
 
-ProfilePropertyValue PropertyGetPrevValue(HProperty hproperty)
+uint32_t PropertyGetChanged(const HProperty** properties)
 {
-    CHECK_HPROPERTY(hproperty)
-    return data->m_PrevValue;
+    const dmArray<ProfileIdx>& changed = g_SnapshotChanged[g_SnapshotFront];
+    *properties = changed.Begin();
+    return changed.Size();
 }
 
 HProperty PropertyGetRoot()
@@ -442,13 +2011,67 @@ static void FrameBegin(void* ctx)
 {
 }
 
+static void SetThreadName(void* ctx, const char* name)
+{
+    (void)ctx;
+    ThreadsSetName(name);
+}
+
+static void LogText(void* ctx, const char* text)
+{
+    (void)ctx;
+    CHECK_INITIALIZED();
+    LogTextAdd(text);
+}
+
 static void FrameEnd(void* ctx)
 {
     (void)ctx;
     CHECK_INITIALIZED();
-    DM_MUTEX_SCOPED_LOCK(g_Lock);
+    SELF_STATS(uint64_t start = dmTime::GetTime());
+    SELF_STATS(SelfStatsRegister());
+
+    {
+        PROPERTY_SCOPED_LOCK();
+        SELF_STATS(uint64_t reset_start = dmTime::GetTime());
+        ResetProperties();
+        SELF_STATS(SelfStatsSetResetTime(dmTime::GetTime() - reset_start));
+        UpdatePropertyTree();
+        PublishAddStats();
+    }
+
+    // The rest only reads the published frame and tree, which only change here, so it doesn't hold up
+    // the threads that register or look up properties in the meantime
+    DerivedFrameEnd();
+    SELF_STATS(SelfStatsFrameEnd());
+    MarkUsedSubtrees();
+    UpdateRollups();
+    RecordHistory();
+    UpdateWindow();
+    TriggersFrameEnd();
+    CaptureFrameEnd();
+    ShmFrameEnd();
+    HttpFrameEnd();
+    LogTextFrameEnd();
+    ScopesFrameEnd();
+    SELF_STATS(SelfStatsSetFrameEndTime(dmTime::GetTime() - start));
+}
+
+// ****************************************************************************
+// Scopes
+
+static void ScopeBegin(void* ctx, const char* name, uint64_t name_hash)
+{
+    (void)ctx;
+    CHECK_INITIALIZED();
+    ScopesBegin(name, name_hash);
+}
 
-    ResetProperties();
+static void ScopeEnd(void* ctx, const char* name, uint64_t name_hash)
+{
+    (void)ctx;
+    CHECK_INITIALIZED();
+    ScopesEnd(name, name_hash);
 }
 
 
@@ -459,15 +2082,41 @@ static void* CreateListener()
 {
     assert(!IsProfileInitialized());
 
+    PropertyInitialize(); // Makes sure the lock exists, even if no properties were registered
+    ScopesInitialize();
+    HistoryInitialize();
+    DerivedInitialize();
+    TriggersInitialize();
+    ThreadsInitialize();
+    LogTextInitialize(g_LogTextCapacity);
+    SELF_STATS(SelfStatsInitialize());
     dmAtomicIncrement32(&g_ProfileInitialized);
 
+    if (g_CapturePath && g_CapturePath[0])
+        CaptureStart(g_CapturePath);
+    if (g_ShmName && g_ShmName[0])
+        ShmStart(g_ShmName, g_ShmCapacity);
+    if (g_HttpPort)
+        HttpStart(g_HttpAddress, (uint16_t)g_HttpPort);
+
     return (void*)(uintptr_t)1;
 }
 
 static void DestroyListener(void* listener)
 {
     CHECK_INITIALIZED();
+    CaptureStop();
+    ShmStop();
+    HttpStop();
     dmAtomicDecrement32(&g_ProfileInitialized);
+    ScopesFinalize();
+    HistoryFinalize();
+    DerivedFinalize();
+    TriggersFinalize();
+    ThreadsFinalize();
+    LogTextFinalize();
+    BaselineFinalize();
+    PropertyFinalize();
     dmMutex::Delete(g_Lock);
     g_Lock = 0;
 }
@@ -481,16 +2130,34 @@ static ProfileListener g_Listener = {};
 
 static dmExtension::Result AppInitialize(dmExtension::AppParams* params)
 {
+    g_HistoryFrameCount = (uint32_t)dmConfigFile::GetInt(params->m_ConfigFile, "profiler_counter.history_frames", 0);
+
+    uint32_t max_property_count = (uint32_t)dmConfigFile::GetInt(params->m_ConfigFile, "profiler_counter.max_properties", (int32_t)g_MaxPropertyCount);
+    if (max_property_count > g_MaxPropertyPageCount * g_PropertyPageSize)
+        max_property_count = g_MaxPropertyPageCount * g_PropertyPageSize;
+    g_MaxPropertyCount = max_property_count;
+
+    g_RollupsEnabled = dmConfigFile::GetInt(params->m_ConfigFile, "profiler_counter.group_rollups", 0) != 0;
+    g_WindowFrameCount = (uint32_t)dmConfigFile::GetInt(params->m_ConfigFile, "profiler_counter.window_frames", 0);
+    g_WindowDuration = (uint32_t)dmConfigFile::GetInt(params->m_ConfigFile, "profiler_counter.window_ms", 0);
+
+    g_CapturePath = dmConfigFile::GetString(params->m_ConfigFile, "profiler_counter.capture_path", 0);
+    g_ShmName = dmConfigFile::GetString(params->m_ConfigFile, "profiler_counter.shm_name", 0);
+    g_ShmCapacity = (uint32_t)dmConfigFile::GetInt(params->m_ConfigFile, "profiler_counter.shm_capacity", (int32_t)g_ShmCapacity);
+    g_LogTextCapacity = (uint32_t)dmConfigFile::GetInt(params->m_ConfigFile, "profiler_counter.log_entries", (int32_t)g_LogTextCapacity);
+    g_HttpAddress = dmConfigFile::GetString(params->m_ConfigFile, "profiler_counter.http_address", g_HttpAddress);
+    g_HttpPort = (uint32_t)dmConfigFile::GetInt(params->m_ConfigFile, "profiler_counter.http_port", 0);
+
     g_Listener.m_Create         = CreateListener;
     g_Listener.m_Destroy        = DestroyListener;
-    g_Listener.m_SetThreadName  = 0;
+    g_Listener.m_SetThreadName  = SetThreadName;
 
     g_Listener.m_FrameBegin     = FrameBegin;
     g_Listener.m_FrameEnd       = FrameEnd;
-    g_Listener.m_ScopeBegin     = 0;            // static void ScopeBegin(void* ctx, const char* name, uint64_t name_hash);
-    g_Listener.m_ScopeEnd       = 0;            // static void ScopeEnd(void* ctx, const char* name, uint64_t name_hash);
+    g_Listener.m_ScopeBegin     = ScopeBegin;
+    g_Listener.m_ScopeEnd       = ScopeEnd;
 
-    g_Listener.m_LogText        = 0;            // static void  LogText(void* listener, const char* text);
+    g_Listener.m_LogText        = LogText;
 
     g_Listener.m_CreatePropertyGroup = ProfileCreatePropertyGroup;
     g_Listener.m_CreatePropertyBool = ProfileCreatePropertyBool;
@@ -533,22 +2200,28 @@ static dmExtension::Result Initialize(dmExtension::Params* params)
     return dmExtension::RESULT_OK;
 }
 
-#if defined(TEST_PROPERTY)
+static dmExtension::Result Finalize(dmExtension::Params* params)
+{
+    ScriptFinalize(params->m_L);
+    return dmExtension::RESULT_OK;
+}
 
+#if defined(TEST_PROPERTY)
 // Allows access from a different file
 DM_PROPERTY_EXTERN(rmtp_TestExtRandom);
 DM_PROPERTY_EXTERN(rmtp_TestExtFrames);
+#endif
 
 static dmExtension::Result Update(dmExtension::Params* params)
 {
+#if defined(TEST_PROPERTY)
     DM_PROPERTY_SET_U32(rmtp_TestExtRandom, rand());
     DM_PROPERTY_ADD_U32(rmtp_TestExtFrames, 1);
+#endif
 
+    // The triggers that fired in the last frame
+    TriggersUpdate();
     return dmExtension::RESULT_OK;
 }
 
-#else
-    #define Update 0
-#endif
-
-DM_DECLARE_EXTENSION(ProfilerCounter, g_ProfilerName, AppInitialize, AppFinalize, Initialize, Update, 0, 0);
+DM_DECLARE_EXTENSION(ProfilerCounter, g_ProfilerName, AppInitialize, AppFinalize, Initialize, Update, 0, Finalize);
@@ -15,24 +15,172 @@ struct PropertyIterator
     PropertyIterator();
 // private
     void* m_IteratorImpl;
+    uint32_t m_End;
     bool m_AllProperties;
     ~PropertyIterator();
 };
 
- // all_properties==false: only those properteis that were changed during the frame.
+ // all_properties==false: only those properties that were written during the frame, and the groups that have any of them below.
 PropertyIterator*       PropertyIterateChildren(HProperty property, bool all_properties, PropertyIterator* iter);
 bool                    PropertyIterateNext(PropertyIterator* iter);
 
+// The property tree flattened in pre-order: a property is followed by its descendants, and siblings are in registration order.
+// It's rebuilt at the end of the frame when properties were registered, so new properties are added from the next frame.
+struct PropertyTreeNode
+{
+    HProperty   m_Property;
+    uint32_t    m_Depth;    // 0 for the root group
+    uint32_t    m_Size;     // Number of nodes in the subtree, including the property itself
+};
+
+// Returns the number of nodes, the root group is the first one
+uint32_t                PropertyGetTree(const PropertyTreeNode** nodes);
+// The subtree of the property is nodes[position, position + nodes[position].m_Size).
+// Returns the number of nodes if the property isn't in the tree yet
+uint32_t                PropertyGetTreePosition(HProperty property);
+// Changes when the tree is rebuilt
+uint32_t                PropertyGetTreeGeneration();
+
 // Property accessors
 
 HProperty               PropertyGetRoot();
 uint32_t                PropertyGetNameHash(HProperty property);
 const char*             PropertyGetName(HProperty property);
 const char*             PropertyGetDesc(HProperty property);
+// Writes the path from the root group, e.g. "Physics/Contacts", truncated to the buffer size
+void                    PropertyGetPath(HProperty property, char* path, uint32_t path_length);
 ProfilePropertyType     PropertyGetType(HProperty property);
 ProfilePropertyValue    PropertyGetValue(HProperty property);
 ProfilePropertyValue    PropertyGetPrevValue(HProperty property);
+// The value from the last frame as a double (bools are 0 or 1, groups are 0)
+double                  PropertyGetPrevNumber(HProperty property);
+
+// Changes every time a property is registered
+uint32_t                PropertyGetGeneration();
+// One past the highest registered engine property index
+uint32_t                PropertyGetCount();
+// The extension's own properties (see PropertyCreate) have the indices [first, first + count),
+// above any index the engine can register
+uint32_t                PropertyGetExtensionFirst();
+uint32_t                PropertyGetExtensionCount();
+// False if no property is registered at that index
+bool                    PropertyIsValid(HProperty property);
+// Is the property in the published tree, i.e. registered before the last frame end.
+// The frame end passes use it instead of PropertyIsValid, as properties may be registered on other threads meanwhile
+bool                    PropertyIsPublished(HProperty property);
+// Was the property written during the last frame (always true for groups)
+bool                    PropertyGetPrevUsed(HProperty property);
+
+uint32_t                PropertyGetPathHash(HProperty property);
+HProperty               PropertyGetParent(HProperty property);
+uint32_t                PropertyGetFlags(HProperty property);
+
+// Number of published frames
+uint32_t                PropertyGetFrame();
+// The properties whose value may have changed in the last published frame. Valid until the next frame.
+uint32_t                PropertyGetChanged(const HProperty** properties);
+
+// Returns PROFILE_PROPERTY_INVALID_IDX if no property has that name.
+// If several properties share a name, the first one registered is returned.
+HProperty               PropertyFindByName(const char* name);
+HProperty               PropertyFindByNameHash(uint32_t name_hash);
+// The path excludes the root group, e.g. "Physics/Contacts"
+HProperty               PropertyFindByPath(const char* path);
+HProperty               PropertyFindByPathHash(uint32_t path_hash);
+
+// Property history (enabled with profiler_counter.history_frames in game.project)
+
+struct PropertyHistoryStats
+{
+    uint32_t    m_Count; // number of frames in the window, fewer if the property was registered during it
+    double      m_Min;
+    double      m_Max;
+    double      m_Mean;
+    double      m_P95;
+    double      m_P99;
+};
+
+// The stats only cover the frames recorded since the property was registered.
+// Returns false if the history is disabled, if the property is a group, or if it has no recorded frames yet
+bool                    PropertyGetHistoryStats(HProperty property, PropertyHistoryStats* stats);
+// Number of frames recorded so far, up to profiler_counter.history_frames
+uint32_t                PropertyGetHistorySize();
+// Copies up to max_count of the most recent frame values, oldest first. Returns the number of values,
+// which is less than PropertyGetHistorySize() if the property was registered during the history window
+uint32_t                PropertyGetHistory(HProperty property, double* values, uint32_t max_count);
+
+// Properties owned by the extension (e.g. derived counters).
+// They are numbered from PropertyGetExtensionFirst(), so they never take an index the engine registers later.
+// They are unregistered when the profiler is destroyed.
+// Returns PROFILE_PROPERTY_INVALID_IDX if the 4096 extension properties are used up
+HProperty               PropertyCreate(const char* name, const char* desc, ProfilePropertyType type, uint32_t flags, HProperty parent);
+// Sets the value of the last published frame directly, for values calculated at the end of the frame.
+// Only called from FrameEnd
+void                    PropertySetFrameValue(HProperty property, ProfilePropertyValue value);
+// Write a number to a property, converted to its type, the same way as the DM_PROPERTY_SET_*/DM_PROPERTY_ADD_* macros.
+// Groups are ignored, and so are bools when adding
+void                    PropertySetNumber(HProperty property, double value);
+void                    PropertyAddNumber(HProperty property, double value);
+
+// Add stats: the distribution of the Add calls to a property during the last frame
+
+static const uint32_t PROPERTY_ADD_STATS_BUCKETS = 32;
 
+struct PropertyAddStats
+{
+    uint32_t    m_Count;    // Number of Add calls
+    double      m_Min;      // Smallest increment, 0 if there were no calls
+    double      m_Max;      // Largest increment, 0 if there were no calls
+    uint32_t    m_Buckets[PROPERTY_ADD_STATS_BUCKETS]; // Bucket i counts the increments where 2^i <= |v| < 2^(i+1) (bucket 0 also those below 1)
+};
+
+// Enables the add stats for a numeric property. The stats are published at the end of each frame.
+// Returns false if the property is a group or a bool
+bool                    PropertyEnableAddStats(HProperty property);
+// Returns false if the add stats aren't enabled for the property
+bool                    PropertyGetAddStats(HProperty property, PropertyAddStats* stats);
+
+// Per thread values. Once enabled, each thread adds to its own slot, without contending with the other threads.
+// The slots are added to the value at the end of the frame, after any Set during the frame, so PropertyGetValue()
+// doesn't include the adds of the current frame. The thread names come from SetThreadName (see threads.h).
+// Returns false for groups
+bool                    PropertyEnableThreadValues(HProperty property);
+// The threads that wrote to the property during the last frame, and what they wrote (the last Set value plus the sum of the adds).
+// Returns the number of threads
+uint32_t                PropertyGetThreadValues(HProperty property, uint32_t* threads, double* values, uint32_t max_count);
+
+// Group roll-ups (enabled with profiler_counter.group_rollups in game.project)
+
+// Aggregate of the numeric (non bool) descendants of a group, over the last frame
+struct PropertyRollup
+{
+    double      m_Sum;
+    double      m_Max;
+    uint32_t    m_Count;
+};
+
+// Returns false if the roll-ups are disabled, or if the property isn't a group
+bool                    PropertyGetRollup(HProperty property, PropertyRollup* rollup);
+
+// Windowed aggregation, enabled with profiler_counter.window_frames and/or profiler_counter.window_ms.
+// The stats of a window are published when it closes, and stay the same until the next one closes.
+struct PropertyWindowInfo
+{
+    uint32_t    m_Index;        // Starts at 1, and increases with each closed window
+    uint32_t    m_FrameCount;
+    uint64_t    m_Duration;     // Microseconds
+};
+
+struct PropertyWindowStats
+{
+    double      m_Sum;      // Sum of the frame values
+    double      m_Average;  // Over the frames the property was registered in
+    double      m_Max;      // Largest frame value
+};
 
+// Returns false if the windows are disabled, or no window has closed yet
+bool                    PropertyGetWindowInfo(PropertyWindowInfo* info);
+// Returns false for groups, and for properties registered after the last window closed
+bool                    PropertyGetWindowStats(HProperty property, PropertyWindowStats* stats);
 
 #endif // DM_PROFILER_H
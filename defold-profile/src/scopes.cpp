@@ -0,0 +1,338 @@
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/hashtable.h>
+#include <dmsdk/dlib/log.h>
+#include <dmsdk/dlib/thread.h>
+#include <dmsdk/dlib/time.h>
+
+#include <atomic>
+#include <stdlib.h> // calloc
+#include <string.h>
+
+#include "scopes.h"
+#include "sharded.h"
+
+// Each thread records begin/end events into its own ring buffer (single producer, single consumer).
+// At the end of the frame, the main thread drains the buffers and aggregates the events per name hash.
+
+static const uint32_t   g_MaxScopeThreads   = 32;
+static const uint32_t   g_ScopeEventCount   = 2048; // Must be a power of two
+static const uint32_t   g_ScopeMaxDepth     = 64;   // Bits in ScopeThread::m_RecordedMask
+static const uint32_t   g_ScopeNameCount    = 256;  // Must be a power of two
+static const uint32_t   g_ScopeNameLength   = 48;
+static const uint32_t   g_ScopeNameInvalid  = 0xFFFFFFFF;
+
+struct ScopeEvent
+{
+    uint64_t    m_NameHash;
+    uint64_t    m_Time;
+    uint32_t    m_Name;     // Index into ScopeThread::m_Names
+    uint32_t    m_Begin;
+};
+
+// The scope names may be dynamic strings, so we keep our own copy of them
+struct ScopeName
+{
+    uint64_t    m_NameHash;
+    char        m_Name[g_ScopeNameLength];
+};
+
+struct ScopeStackEntry
+{
+    uint32_t    m_Stats;
+    uint64_t    m_Start;
+    uint64_t    m_ChildTime;
+};
+
+struct ScopeThread
+{
+    // Owned by the recording thread
+    ScopeEvent              m_Events[g_ScopeEventCount];
+    ScopeName               m_Names[g_ScopeNameCount];
+    std::atomic<uint32_t>   m_WriteIndex;
+    uint64_t                m_RecordedMask; // Which of the open scopes made it into the buffer
+    uint32_t                m_Depth;
+    uint32_t                m_OpenRecorded; // Number of recorded begin events still waiting for their end event
+
+    // Owned by the main thread
+    std::atomic<uint32_t>   m_ReadIndex;
+    ScopeStackEntry         m_Stack[g_ScopeMaxDepth];
+    uint32_t                m_StackDepth;
+};
+
+// The TLS value holds the buffer index + 1 in the low bits, and the generation it was claimed in above them.
+// A value from an earlier generation is stale (the key may be handed out again after ScopesFinalize), and the
+// thread claims a new buffer
+static const uint32_t               g_ScopeThreadIndexBits = 8;
+static const uint32_t               g_ScopeThreadIndexMask = (1u << g_ScopeThreadIndexBits) - 1;
+static const uint32_t               g_ScopeThreadOverflow = g_MaxScopeThreads + 1; // For threads that didn't get a buffer
+static const uint32_t               g_ScopeGenerationMask = 0xFFFFFF;
+
+static dmThread::TlsKey             g_ScopeThreadKey;
+static std::atomic<ScopeThread*>    g_ScopeThreadPool(0); // g_MaxScopeThreads buffers, allocated up front
+static std::atomic<uint32_t>        g_ScopeThreadCount(0);
+static uint32_t                     g_ScopeGeneration = 0;
+static ShardedCounter               g_ScopeWriters; // Threads inside ScopesBegin/ScopesEnd
+
+static dmArray<ScopeStats>          g_ScopeStats[2];
+static uint32_t                     g_ScopeStatsFront = 0;
+static dmHashTable64<uint32_t>      g_ScopeStatsIndices;
+
+static const char*                  g_ScopeUnknownName = "<unknown>";
+
+// ****************************************************************************
+// Recording threads
+
+static ScopeThread* GetScopeThread(ScopeThread* pool)
+{
+    uintptr_t value = (uintptr_t)dmThread::GetTlsValue(g_ScopeThreadKey);
+    if (value && (value >> g_ScopeThreadIndexBits) == g_ScopeGeneration)
+    {
+        uint32_t slot = (uint32_t)(value & g_ScopeThreadIndexMask);
+        return slot != g_ScopeThreadOverflow ? &pool[slot - 1] : 0;
+    }
+
+    uint32_t generation = (uint32_t)g_ScopeGeneration << g_ScopeThreadIndexBits;
+    uint32_t index = g_ScopeThreadCount.fetch_add(1, std::memory_order_relaxed);
+    if (index >= g_MaxScopeThreads)
+    {
+        dmLogWarning("Max number of profiled threads (%u) reached, scopes will be ignored on this thread", g_MaxScopeThreads);
+        dmThread::SetTlsValue(g_ScopeThreadKey, (void*)(uintptr_t)(generation | g_ScopeThreadOverflow));
+        return 0;
+    }
+
+    // The buffer is already allocated, the thread only claims it
+    dmThread::SetTlsValue(g_ScopeThreadKey, (void*)(uintptr_t)(generation | (index + 1)));
+    return &pool[index];
+}
+
+static uint32_t InternScopeName(ScopeThread* thread, const char* name, uint64_t name_hash)
+{
+    uint32_t mask = g_ScopeNameCount - 1;
+    for (uint32_t i = 0; i < g_ScopeNameCount; ++i)
+    {
+        uint32_t slot = (uint32_t)(name_hash + i) & mask;
+        ScopeName* entry = &thread->m_Names[slot];
+        if (entry->m_NameHash == name_hash)
+            return slot;
+        if (entry->m_NameHash == 0)
+        {
+            strncpy(entry->m_Name, name ? name : g_ScopeUnknownName, g_ScopeNameLength - 1);
+            entry->m_NameHash = name_hash;
+            return slot;
+        }
+    }
+    return g_ScopeNameInvalid;
+}
+
+static void RecordBegin(ScopeThread* thread, const char* name, uint64_t name_hash)
+{
+    uint32_t depth = thread->m_Depth++;
+    if (depth >= g_ScopeMaxDepth)
+        return;
+
+    uint64_t bit = 1ULL << depth;
+    uint32_t write = thread->m_WriteIndex.load(std::memory_order_relaxed);
+    uint32_t read = thread->m_ReadIndex.load(std::memory_order_acquire);
+
+    // Always keep room for the end events of the scopes that are already open
+    if (g_ScopeEventCount - (write - read) < thread->m_OpenRecorded + 2)
+    {
+        thread->m_RecordedMask &= ~bit;
+        return;
+    }
+
+    ScopeEvent* event = &thread->m_Events[write & (g_ScopeEventCount - 1)];
+    event->m_NameHash   = name_hash;
+    event->m_Name       = InternScopeName(thread, name, name_hash);
+    event->m_Begin      = 1;
+    event->m_Time       = dmTime::GetTime();
+    thread->m_WriteIndex.store(write + 1, std::memory_order_release);
+
+    thread->m_RecordedMask |= bit;
+    thread->m_OpenRecorded++;
+}
+
+static void RecordEnd(ScopeThread* thread, uint64_t name_hash, uint64_t time)
+{
+    if (thread->m_Depth == 0)
+        return;
+
+    uint32_t depth = --thread->m_Depth;
+    if (depth >= g_ScopeMaxDepth)
+        return;
+
+    uint64_t bit = 1ULL << depth;
+    if ((thread->m_RecordedMask & bit) == 0)
+        return;
+    thread->m_RecordedMask &= ~bit;
+    thread->m_OpenRecorded--;
+
+    // There is always room, since it was reserved by the begin event
+    uint32_t write = thread->m_WriteIndex.load(std::memory_order_relaxed);
+    ScopeEvent* event = &thread->m_Events[write & (g_ScopeEventCount - 1)];
+    event->m_NameHash   = name_hash;
+    event->m_Name       = g_ScopeNameInvalid;
+    event->m_Begin      = 0;
+    event->m_Time       = time;
+    thread->m_WriteIndex.store(write + 1, std::memory_order_release);
+}
+
+// The writer count keeps ScopesFinalize from freeing the buffers under us
+void ScopesBegin(const char* name, uint64_t name_hash)
+{
+    uint32_t line = ShardedEnter(&g_ScopeWriters);
+    ScopeThread* pool = g_ScopeThreadPool.load();
+    ScopeThread* thread = pool ? GetScopeThread(pool) : 0;
+    if (thread)
+        RecordBegin(thread, name, name_hash);
+    ShardedLeave(&g_ScopeWriters, line);
+}
+
+void ScopesEnd(const char* name, uint64_t name_hash)
+{
+    (void)name;
+    uint64_t time = dmTime::GetTime();
+
+    uint32_t line = ShardedEnter(&g_ScopeWriters);
+    ScopeThread* pool = g_ScopeThreadPool.load();
+    ScopeThread* thread = pool ? GetScopeThread(pool) : 0;
+    if (thread)
+        RecordEnd(thread, name_hash, time);
+    ShardedLeave(&g_ScopeWriters, line);
+}
+
+// ****************************************************************************
+// Aggregation
+
+static uint32_t GetScopeStatsIndex(ScopeThread* thread, const ScopeEvent* event)
+{
+    uint32_t* index = g_ScopeStatsIndices.Get(event->m_NameHash);
+    if (index)
+        return *index;
+
+    if (g_ScopeStats[0].Full())
+    {
+        uint32_t capacity = g_ScopeStats[0].Capacity() + 64;
+        g_ScopeStats[0].SetCapacity(capacity);
+        g_ScopeStats[1].SetCapacity(capacity);
+    }
+    if (g_ScopeStatsIndices.Full())
+    {
+        uint32_t capacity = g_ScopeStatsIndices.Capacity() + 64;
+        g_ScopeStatsIndices.SetCapacity(capacity / 2 + 1, capacity);
+    }
+
+    ScopeStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.m_NameHash = event->m_NameHash;
+    stats.m_Name = event->m_Name != g_ScopeNameInvalid ? thread->m_Names[event->m_Name].m_Name : g_ScopeUnknownName;
+
+    uint32_t new_index = g_ScopeStats[0].Size();
+    g_ScopeStats[0].Push(stats);
+    g_ScopeStats[1].Push(stats);
+    g_ScopeStatsIndices.Put(event->m_NameHash, new_index);
+    return new_index;
+}
+
+static void DrainScopeThread(ScopeThread* thread, dmArray<ScopeStats>& stats)
+{
+    uint32_t read = thread->m_ReadIndex.load(std::memory_order_relaxed);
+    uint32_t write = thread->m_WriteIndex.load(std::memory_order_acquire);
+
+    for (; read != write; ++read)
+    {
+        const ScopeEvent* event = &thread->m_Events[read & (g_ScopeEventCount - 1)];
+        if (event->m_Begin)
+        {
+            ScopeStackEntry* entry = &thread->m_Stack[thread->m_StackDepth++];
+            entry->m_Stats      = GetScopeStatsIndex(thread, event);
+            entry->m_Start      = event->m_Time;
+            entry->m_ChildTime  = 0;
+            continue;
+        }
+
+        if (thread->m_StackDepth == 0)
+            continue;
+
+        ScopeStackEntry* entry = &thread->m_Stack[--thread->m_StackDepth];
+        uint64_t total = event->m_Time >= entry->m_Start ? event->m_Time - entry->m_Start : 0;
+        uint64_t child = entry->m_ChildTime < total ? entry->m_ChildTime : total;
+
+        ScopeStats* s = &stats[entry->m_Stats];
+        s->m_TotalTime += total;
+        s->m_SelfTime += total - child;
+        s->m_Count++;
+
+        if (thread->m_StackDepth > 0)
+            thread->m_Stack[thread->m_StackDepth - 1].m_ChildTime += total;
+    }
+
+    thread->m_ReadIndex.store(read, std::memory_order_release);
+}
+
+void ScopesFrameEnd()
+{
+    dmArray<ScopeStats>& back = g_ScopeStats[1 - g_ScopeStatsFront];
+    for (uint32_t i = 0; i < back.Size(); ++i)
+    {
+        back[i].m_TotalTime = 0;
+        back[i].m_SelfTime = 0;
+        back[i].m_Count = 0;
+    }
+
+    ScopeThread* pool = g_ScopeThreadPool.load(std::memory_order_relaxed);
+    uint32_t thread_count = g_ScopeThreadCount.load(std::memory_order_relaxed);
+    if (thread_count > g_MaxScopeThreads)
+        thread_count = g_MaxScopeThreads;
+
+    // A buffer that was just claimed has no events yet, which the acquire on its write index sorts out
+    for (uint32_t i = 0; pool && i < thread_count; ++i)
+        DrainScopeThread(&pool[i], back);
+
+    g_ScopeStatsFront = 1 - g_ScopeStatsFront;
+}
+
+uint32_t ScopesGetCount()
+{
+    return g_ScopeStats[g_ScopeStatsFront].Size();
+}
+
+const ScopeStats* ScopesGetStats(uint32_t index)
+{
+    return &g_ScopeStats[g_ScopeStatsFront][index];
+}
+
+// ****************************************************************************
+
+void ScopesInitialize()
+{
+    g_ScopeThreadKey = dmThread::AllocTls();
+    g_ScopeThreadCount.store(0, std::memory_order_relaxed);
+    g_ScopeGeneration = (g_ScopeGeneration + 1) & g_ScopeGenerationMask;
+    if (g_ScopeGeneration == 0)
+        g_ScopeGeneration = 1;
+
+    // All the buffers up front, so that a thread doesn't allocate on its first scope. The pages of the
+    // buffers that are never claimed are never touched either
+    g_ScopeThreadPool.store((ScopeThread*)calloc(g_MaxScopeThreads, sizeof(ScopeThread)));
+
+    g_ScopeStats[0].SetCapacity(64);
+    g_ScopeStats[1].SetCapacity(64);
+    g_ScopeStatsIndices.SetCapacity(33, 64);
+    g_ScopeStatsFront = 0;
+}
+
+void ScopesFinalize()
+{
+    // New writers see the null pool and leave. Wait for the ones that are still recording
+    ScopeThread* pool = g_ScopeThreadPool.exchange(0);
+    ShardedDrain(&g_ScopeWriters);
+    free(pool);
+
+    g_ScopeThreadCount.store(0, std::memory_order_relaxed);
+    dmThread::FreeTls(g_ScopeThreadKey);
+
+    g_ScopeStats[0].SetSize(0);
+    g_ScopeStats[1].SetSize(0);
+    g_ScopeStatsIndices.Clear();
+}
@@ -0,0 +1,30 @@
+#ifndef DM_PROFILER_SCOPES_H
+#define DM_PROFILER_SCOPES_H
+
+#include <stdint.h>
+
+// Scope timings, aggregated per name hash over the last finished frame
+
+struct ScopeStats
+{
+    const char* m_Name;
+    uint64_t    m_NameHash;
+    uint64_t    m_TotalTime;    // microseconds
+    uint64_t    m_SelfTime;     // microseconds, excluding the time spent in child scopes
+    uint32_t    m_Count;
+};
+
+void                ScopesInitialize();
+void                ScopesFinalize();
+
+// May be called from any thread. No locks and no allocations
+void                ScopesBegin(const char* name, uint64_t name_hash);
+void                ScopesEnd(const char* name, uint64_t name_hash);
+
+// Called from the main thread
+void                ScopesFrameEnd();
+
+uint32_t            ScopesGetCount();
+const ScopeStats*   ScopesGetStats(uint32_t index);
+
+#endif // DM_PROFILER_SCOPES_H
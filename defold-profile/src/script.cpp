@@ -1,10 +1,21 @@
 // include the Defold SDK
 #include <dmsdk/sdk.h>
+#include <dmsdk/dlib/dstrings.h>
 #include <dmsdk/dlib/profile.h>
+#include <dmsdk/dlib/time.h>
 
+#include "baseline.h"
+#include "capture.h"
+#include "derived.h"
+#include "logtext.h"
 #include "profiler.h"
+#include "scopes.h"
+#include "selfstats.h"
+#include "threads.h"
+#include "triggers.h"
 
 #define MODULE_NAME "profile"
+#define SNAPSHOT_TYPE_NAME "profile.snapshot"
 
 #if defined(TEST_PROPERTY)
 DM_PROPERTY_GROUP(rmtp_TestExt, "TestCounters", 0);
@@ -33,17 +44,22 @@ DM_PROPERTY_U32(rmtp_TestExtFrames, 0, 0, "frame count", &rmtp_TestExt);
 //     }
 // }
 
-static int PushProperty(lua_State* L, bool all_properties, HProperty property)
-{
-    const char* name            = PropertyGetName(property);
-    ProfilePropertyType type    = PropertyGetType(property);
-    ProfilePropertyValue value  = PropertyGetPrevValue(property);
+// Cached property tree, updated in place by get_properties({reuse = true})
+static int                  g_CachedTreeRef = LUA_NOREF;
+static int                  g_CachedNodesRef = LUA_NOREF;   // The value nodes of the tree, in the same order as g_CachedNodes
+static uint32_t             g_CachedGeneration = 0;    // The tree generation it was built from
+static HProperty            g_CachedRoot = PROFILE_PROPERTY_INVALID_IDX;
+static dmArray<HProperty>   g_CachedNodes;
 
-    //DebugPrintProperty(property);
-
-    lua_pushstring(L, name);
-    lua_setfield(L, -2, "name");
+struct PushPropertyContext
+{
+    bool        m_AllProperties;
+    int         m_NodesIndex;   // Stack index of the table collecting the value nodes, or 0
+    uint32_t    m_NumNodes;
+};
 
+static void PushPropertyValue(lua_State* L, ProfilePropertyType type, ProfilePropertyValue value)
+{
     switch (type)
     {
         case PROFILE_PROPERTY_TYPE_GROUP:   lua_pushnil(L); break;
@@ -56,20 +72,164 @@ static int PushProperty(lua_State* L, bool all_properties, HProperty property)
         case PROFILE_PROPERTY_TYPE_F64:     lua_pushnumber(L, value.m_F64); break;
         default:                            lua_pushstring(L, "unknown type"); break;
     }
-    lua_setfield(L, -2, "value");
+}
+
+// Sets the roll-up fields of the group table on top of the stack
+static void SetRollupFields(lua_State* L, const PropertyRollup* rollup)
+{
+    lua_pushnumber(L, rollup->m_Sum);
+    lua_setfield(L, -2, "sum");
+
+    lua_pushinteger(L, rollup->m_Count);
+    lua_setfield(L, -2, "count");
+
+    lua_pushnumber(L, rollup->m_Max);
+    lua_setfield(L, -2, "max");
+}
+
+// Sets the fields of the add stats table on top of the stack. The buckets table is reused if it's already there
+static void SetAddStatsFields(lua_State* L, const PropertyAddStats* stats)
+{
+    lua_pushinteger(L, stats->m_Count);
+    lua_setfield(L, -2, "count");
+
+    lua_pushnumber(L, stats->m_Min);
+    lua_setfield(L, -2, "min");
+
+    lua_pushnumber(L, stats->m_Max);
+    lua_setfield(L, -2, "max");
+
+    lua_getfield(L, -1, "buckets");
+    if (!lua_istable(L, -1))
+    {
+        lua_pop(L, 1);
+        lua_createtable(L, PROPERTY_ADD_STATS_BUCKETS, 0);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -3, "buckets");
+    }
+    for (uint32_t i = 0; i < PROPERTY_ADD_STATS_BUCKETS; ++i)
+    {
+        lua_pushinteger(L, stats->m_Buckets[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_pop(L, 1);
+}
+
+// Sets (or updates) the "adds" field of the property table on top of the stack, if the property has add stats
+static void SetAddStatsField(lua_State* L, HProperty property)
+{
+    PropertyAddStats stats;
+    if (!PropertyGetAddStats(property, &stats))
+        return;
+
+    lua_getfield(L, -1, "adds");
+    if (!lua_istable(L, -1))
+    {
+        lua_pop(L, 1);
+        lua_createtable(L, 0, 4);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -3, "adds");
+    }
+    SetAddStatsFields(L, &stats);
+    lua_pop(L, 1);
+}
+
+// Fills the table on top of the stack with {[thread name] = value}, and removes the threads from earlier frames.
+// Threads with the same name are summed up
+static void SetThreadValuesFields(lua_State* L, uint32_t count, const uint32_t* threads, const double* values)
+{
+    lua_pushnil(L);
+    while (lua_next(L, -2))
+    {
+        lua_pop(L, 1);
+        lua_pushvalue(L, -1);
+        lua_pushnil(L);
+        lua_rawset(L, -4);
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const char* name = ThreadsGetName(threads[i]);
+        lua_getfield(L, -1, name);
+        double value = values[i] + lua_tonumber(L, -1);
+        lua_pop(L, 1);
+        lua_pushnumber(L, value);
+        lua_setfield(L, -2, name);
+    }
+}
+
+// Sets (or updates) the "threads" field of the property table on top of the stack, if any thread wrote to the property
+static void SetThreadValuesField(lua_State* L, HProperty property)
+{
+    uint32_t threads[THREADS_SLOT_COUNT];
+    double values[THREADS_SLOT_COUNT];
+    uint32_t count = PropertyGetThreadValues(property, threads, values, THREADS_SLOT_COUNT);
 
+    lua_getfield(L, -1, "threads");
+    if (!lua_istable(L, -1))
+    {
+        lua_pop(L, 1);
+        if (!count)
+            return;
+        lua_createtable(L, 0, count);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -3, "threads");
+    }
+    SetThreadValuesFields(L, count, threads, values);
+    lua_pop(L, 1);
+}
+
+static const char* GetPropertyTypeName(ProfilePropertyType type)
+{
     switch (type)
     {
-        case PROFILE_PROPERTY_TYPE_GROUP:   lua_pushstring(L, "Group"); break;
-        case PROFILE_PROPERTY_TYPE_BOOL:    lua_pushstring(L, "Bool"); break;
-        case PROFILE_PROPERTY_TYPE_S32:     lua_pushstring(L, "S32"); break;
-        case PROFILE_PROPERTY_TYPE_U32:     lua_pushstring(L, "U32"); break;
-        case PROFILE_PROPERTY_TYPE_S64:     lua_pushstring(L, "S64"); break;
-        case PROFILE_PROPERTY_TYPE_U64:     lua_pushstring(L, "U64"); break;
-        case PROFILE_PROPERTY_TYPE_F32:     lua_pushstring(L, "F32"); break;
-        case PROFILE_PROPERTY_TYPE_F64:     lua_pushstring(L, "F64"); break;
-        default:                            lua_pushstring(L, "unknown"); break;
+        case PROFILE_PROPERTY_TYPE_GROUP:   return "Group";
+        case PROFILE_PROPERTY_TYPE_BOOL:    return "Bool";
+        case PROFILE_PROPERTY_TYPE_S32:     return "S32";
+        case PROFILE_PROPERTY_TYPE_U32:     return "U32";
+        case PROFILE_PROPERTY_TYPE_S64:     return "S64";
+        case PROFILE_PROPERTY_TYPE_U64:     return "U64";
+        case PROFILE_PROPERTY_TYPE_F32:     return "F32";
+        case PROFILE_PROPERTY_TYPE_F64:     return "F64";
+        default:                            return "unknown";
     }
+}
+
+static int PushProperty(lua_State* L, PushPropertyContext* ctx, HProperty property)
+{
+    const char* name            = PropertyGetName(property);
+    ProfilePropertyType type    = PropertyGetType(property);
+    ProfilePropertyValue value  = PropertyGetPrevValue(property);
+    ++ctx->m_NumNodes;
+
+    //DebugPrintProperty(property);
+
+    lua_pushstring(L, name);
+    lua_setfield(L, -2, "name");
+
+    PushPropertyValue(L, type, value);
+    lua_setfield(L, -2, "value");
+
+    PropertyRollup rollup;
+    bool has_rollup = type == PROFILE_PROPERTY_TYPE_GROUP && PropertyGetRollup(property, &rollup);
+    if (has_rollup)
+        SetRollupFields(L, &rollup);
+    else
+    {
+        SetAddStatsField(L, property);
+        SetThreadValuesField(L, property);
+    }
+
+    if (ctx->m_NodesIndex && (type != PROFILE_PROPERTY_TYPE_GROUP || has_rollup))
+    {
+        if (g_CachedNodes.Full())
+            g_CachedNodes.OffsetCapacity(g_CachedNodes.Capacity() + 64);
+        g_CachedNodes.Push(property);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, ctx->m_NodesIndex, g_CachedNodes.Size());
+    }
+
+    lua_pushstring(L, GetPropertyTypeName(type));
     lua_setfield(L, -2, "type");
 
     // lua_createtable(L, 0, 0);
@@ -90,12 +250,12 @@ static int PushProperty(lua_State* L, bool all_properties, HProperty property)
 
     // Each property type may have children
     PropertyIterator iter;
-    PropertyIterateChildren(property, all_properties, &iter);
+    PropertyIterateChildren(property, ctx->m_AllProperties, &iter);
     uint32_t num_children = 0;
     while (PropertyIterateNext(&iter))
     {
         lua_createtable(L, 0, 0);
-            PushProperty(L, all_properties, iter.m_Property);
+            PushProperty(L, ctx, iter.m_Property);
             lua_rawseti(L, -2, ++num_children);
     }
 
@@ -111,19 +271,986 @@ static int PushProperty(lua_State* L, bool all_properties, HProperty property)
     return 1;
 }
 
+// Builds the tree once, and stores it in the registry together with a flat list of its value nodes
+// Returns the number of nodes in the tree
+static uint32_t BuildCachedProperties(lua_State* L, HProperty root)
+{
+    luaL_unref(L, LUA_REGISTRYINDEX, g_CachedTreeRef);
+    luaL_unref(L, LUA_REGISTRYINDEX, g_CachedNodesRef);
+    g_CachedNodes.SetSize(0);
+    g_CachedGeneration = PropertyGetTreeGeneration();
+    g_CachedRoot = root;
+
+    lua_createtable(L, 0, 0);
+    PushPropertyContext ctx;
+    ctx.m_AllProperties = true;
+    ctx.m_NodesIndex = lua_gettop(L);
+    ctx.m_NumNodes = 0;
+
+    lua_createtable(L, 0, 0);
+    PushProperty(L, &ctx, root);
+
+    g_CachedTreeRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    g_CachedNodesRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    return ctx.m_NumNodes;
+}
+
+// Only the "value" fields (and the group roll-ups and add stats) are updated, which doesn't create any garbage
+static void UpdateCachedProperties(lua_State* L)
+{
+    lua_rawgeti(L, LUA_REGISTRYINDEX, g_CachedNodesRef);
+    for (uint32_t i = 0; i < g_CachedNodes.Size(); ++i)
+    {
+        HProperty property = g_CachedNodes[i];
+        ProfilePropertyType type = PropertyGetType(property);
+        lua_rawgeti(L, -1, i + 1);
+        PropertyRollup rollup;
+        if (type == PROFILE_PROPERTY_TYPE_GROUP)
+        {
+            if (PropertyGetRollup(property, &rollup))
+                SetRollupFields(L, &rollup);
+        }
+        else
+        {
+            PushPropertyValue(L, type, PropertyGetPrevValue(property));
+            lua_setfield(L, -2, "value");
+            SetAddStatsField(L, property);
+            SetThreadValuesField(L, property);
+        }
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+}
+
+// The handles from create_counter() are light userdata holding the index + 1, so that they don't allocate
+static inline HProperty ToCounter(lua_State* L, int index)
+{
+    return (HProperty)((uintptr_t)lua_touserdata(L, index) - 1);
+}
+
+// A property is found from its path (e.g. "Physics/Contacts") or its name, or from the 32 bit hash of either,
+// or from a create_counter() handle. Returns PROFILE_PROPERTY_INVALID_IDX if it isn't found
+static HProperty FindProperty(lua_State* L, int index)
+{
+    if (lua_type(L, index) == LUA_TLIGHTUSERDATA)
+    {
+        HProperty property = ToCounter(L, index);
+        return PropertyIsValid(property) ? property : PROFILE_PROPERTY_INVALID_IDX;
+    }
+
+    uint32_t hash;
+    if (lua_type(L, index) == LUA_TNUMBER)
+        hash = (uint32_t)lua_tonumber(L, index);
+    else
+        hash = dmHashString32(luaL_checkstring(L, index));
+
+    HProperty property = PropertyFindByPathHash(hash);
+    if (property == PROFILE_PROPERTY_INVALID_IDX)
+        property = PropertyFindByNameHash(hash);
+    return property;
+}
+
+// Like FindProperty, but raises an error if the property isn't found
+static HProperty CheckProperty(lua_State* L, int index)
+{
+    HProperty property = FindProperty(L, index);
+    if (property == PROFILE_PROPERTY_INVALID_IDX)
+        luaL_error(L, "Property '%s' not found", lua_tostring(L, index));
+    return property;
+}
+
+// Options:
+//   reuse          update the tree from the previous call in place, instead of creating a new one
+//   changed_only   only the properties written during the last frame, and the groups above them
+//   root           path or name of the group (or property) to start from, instead of the root group
 static int GetProfileProperties(lua_State* L)
 {
-    bool all_properties = true;//lua_toboolean(L, 1);
+    SELF_STATS(uint64_t start = dmTime::GetTime());
+    bool reuse = false;
+    bool changed_only = false;
     HProperty root = PropertyGetRoot();
+    if (lua_istable(L, 1))
+    {
+        lua_getfield(L, 1, "reuse");
+        reuse = lua_toboolean(L, -1);
+        lua_getfield(L, 1, "changed_only");
+        changed_only = lua_toboolean(L, -1);
+        lua_getfield(L, 1, "root");
+        if (!lua_isnil(L, -1))
+            root = CheckProperty(L, -1);
+        lua_pop(L, 3);
+    }
+
+    if (reuse)
+    {
+        // The shape of the cached tree is fixed, while the changed properties differ from frame to frame
+        if (changed_only)
+            return luaL_error(L, "The 'reuse' and 'changed_only' options cannot be combined");
+
+        uint32_t num_nodes;
+        if (g_CachedTreeRef == LUA_NOREF || g_CachedGeneration != PropertyGetTreeGeneration() || g_CachedRoot != root)
+            num_nodes = BuildCachedProperties(L, root);
+        else
+        {
+            UpdateCachedProperties(L);
+            num_nodes = g_CachedNodes.Size();
+        }
+        lua_rawgeti(L, LUA_REGISTRYINDEX, g_CachedTreeRef);
+        SELF_STATS(SelfStatsSetExport(dmTime::GetTime() - start, num_nodes));
+        (void)num_nodes;
+        return 1;
+    }
+
+    PushPropertyContext ctx;
+    ctx.m_AllProperties = !changed_only;
+    ctx.m_NodesIndex = 0;
+    ctx.m_NumNodes = 0;
+
     lua_createtable(L, 0, 0); // we don't know how many items beforehand
-    PushProperty(L, all_properties, root);
+    PushProperty(L, &ctx, root);
+    SELF_STATS(SelfStatsSetExport(dmTime::GetTime() - start, ctx.m_NumNodes));
+    return 1;
+}
+
+// Pushes the value from the last frame, or nil for unknown properties.
+// Groups push the sum of their descendants if the roll-ups are enabled, otherwise nil
+static void PushPrevValue(lua_State* L, HProperty property)
+{
+    PropertyRollup rollup;
+    if (property == PROFILE_PROPERTY_INVALID_IDX)
+        lua_pushnil(L);
+    else if (PropertyGetType(property) == PROFILE_PROPERTY_TYPE_GROUP && PropertyGetRollup(property, &rollup))
+        lua_pushnumber(L, rollup.m_Sum);
+    else
+        PushPropertyValue(L, PropertyGetType(property), PropertyGetPrevValue(property));
+}
+
+static int GetProfileValue(lua_State* L)
+{
+    PushPrevValue(L, FindProperty(L, 1));
+    return 1;
+}
+
+// Returns the values in the same order as the names. Pass a table as the second argument to have it reused
+static int GetProfileValues(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int count = (int)lua_objlen(L, 1);
+
+    if (lua_istable(L, 2))
+        lua_pushvalue(L, 2);
+    else
+        lua_createtable(L, count, 0);
+
+    for (int i = 1; i <= count; ++i)
+    {
+        lua_rawgeti(L, 1, i);
+        HProperty property = FindProperty(L, -1);
+        lua_pop(L, 1);
+
+        PushPrevValue(L, property);
+        lua_rawseti(L, -2, i);
+    }
+    return 1;
+}
+
+// ****************************************************************************
+// Snapshot
+//
+// A userdata view over the published frame. It holds no data itself, everything is read
+// lazily from the native snapshot, using the property index + 1 as the Lua index.
+// #snapshot covers the engine properties, the extension's own ones are above that, and are found with snapshot:find().
+
+static int g_SnapshotRef = LUA_NOREF;
+
+static HProperty CheckSnapshotIndex(lua_State* L, int index)
+{
+    luaL_checkudata(L, 1, SNAPSHOT_TYPE_NAME);
+    lua_Integer i = luaL_checkinteger(L, index);
+    if (i < 1 || i - 1 >= (lua_Integer)(PropertyGetExtensionFirst() + PropertyGetExtensionCount()) || !PropertyIsValid((HProperty)(i - 1)))
+        return PROFILE_PROPERTY_INVALID_IDX;
+    return (HProperty)(i - 1);
+}
+
+static int Snapshot_Value(lua_State* L)
+{
+    PushPrevValue(L, CheckSnapshotIndex(L, 2));
+    return 1;
+}
+
+static int Snapshot_Type(lua_State* L)
+{
+    HProperty property = CheckSnapshotIndex(L, 2);
+    if (property == PROFILE_PROPERTY_INVALID_IDX)
+        lua_pushnil(L);
+    else
+        lua_pushstring(L, GetPropertyTypeName(PropertyGetType(property)));
+    return 1;
+}
+
+static int Snapshot_Name(lua_State* L)
+{
+    HProperty property = CheckSnapshotIndex(L, 2);
+    if (property == PROFILE_PROPERTY_INVALID_IDX)
+        lua_pushnil(L);
+    else
+        lua_pushstring(L, PropertyGetName(property));
+    return 1;
+}
+
+static int Snapshot_Hash(lua_State* L)
+{
+    HProperty property = CheckSnapshotIndex(L, 2);
+    if (property == PROFILE_PROPERTY_INVALID_IDX)
+        lua_pushnil(L);
+    else
+        lua_pushnumber(L, PropertyGetNameHash(property));
+    return 1;
+}
+
+static int Snapshot_Used(lua_State* L)
+{
+    HProperty property = CheckSnapshotIndex(L, 2);
+    lua_pushboolean(L, property != PROFILE_PROPERTY_INVALID_IDX && PropertyGetPrevUsed(property));
+    return 1;
+}
+
+// Finds the index from a property path, name or hash
+static int Snapshot_Find(lua_State* L)
+{
+    luaL_checkudata(L, 1, SNAPSHOT_TYPE_NAME);
+    HProperty property = FindProperty(L, 2);
+
+    if (property == PROFILE_PROPERTY_INVALID_IDX)
+        lua_pushnil(L);
+    else
+        lua_pushinteger(L, property + 1);
+    return 1;
+}
+
+static int Snapshot_Count(lua_State* L)
+{
+    luaL_checkudata(L, 1, SNAPSHOT_TYPE_NAME);
+    lua_pushinteger(L, PropertyGetCount());
+    return 1;
+}
+
+// snapshot[i] is the value, other keys are looked up in the metatable
+static int Snapshot_Index(lua_State* L)
+{
+    if (lua_type(L, 2) == LUA_TNUMBER)
+        return Snapshot_Value(L);
+
+    luaL_getmetatable(L, SNAPSHOT_TYPE_NAME);
+    lua_pushvalue(L, 2);
+    lua_rawget(L, -2);
+    return 1;
+}
+
+static const luaL_reg Snapshot_methods[] =
+{
+    {"value", Snapshot_Value},
+    {"type", Snapshot_Type},
+    {"name", Snapshot_Name},
+    {"hash", Snapshot_Hash},
+    {"used", Snapshot_Used},
+    {"find", Snapshot_Find},
+    {"count", Snapshot_Count},
+    {"__len", Snapshot_Count},
+    {"__index", Snapshot_Index},
+    {0, 0}
+};
+
+// The same userdata is returned every time, so this doesn't allocate
+static int GetProfileSnapshot(lua_State* L)
+{
+    if (g_SnapshotRef == LUA_NOREF)
+    {
+        lua_newuserdata(L, 1);
+        luaL_getmetatable(L, SNAPSHOT_TYPE_NAME);
+        lua_setmetatable(L, -2);
+        g_SnapshotRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    lua_rawgeti(L, LUA_REGISTRYINDEX, g_SnapshotRef);
+    return 1;
+}
+
+// ****************************************************************************
+
+// Pushes the table at the index if there is one, or a new table
+static void PushResultTable(lua_State* L, int index, int num_fields)
+{
+    if (lua_istable(L, index))
+        lua_pushvalue(L, index);
+    else
+        lua_createtable(L, 0, num_fields);
+}
+
+static int GetProfileStats(lua_State* L)
+{
+    HProperty property = FindProperty(L, 1);
+
+    PropertyHistoryStats stats;
+    if (!PropertyGetHistoryStats(property, &stats))
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    PushResultTable(L, 2, 6);
+
+        lua_pushinteger(L, stats.m_Count);
+        lua_setfield(L, -2, "count");
+
+        lua_pushnumber(L, stats.m_Min);
+        lua_setfield(L, -2, "min");
+
+        lua_pushnumber(L, stats.m_Max);
+        lua_setfield(L, -2, "max");
+
+        lua_pushnumber(L, stats.m_Mean);
+        lua_setfield(L, -2, "mean");
+
+        lua_pushnumber(L, stats.m_P95);
+        lua_setfield(L, -2, "p95");
+
+        lua_pushnumber(L, stats.m_P99);
+        lua_setfield(L, -2, "p99");
+
     return 1;
 }
 
+static const uint32_t g_WindowMaxDepth = 32;
+
+// Returns {index, frames, duration (ms), values = {[path] = {sum, avg, max}}} for the last closed window,
+// or nil until the first window closes. Pass the previous table to have it, and its value tables, reused
+static int GetProfileWindow(lua_State* L)
+{
+    PropertyWindowInfo info;
+    if (!PropertyGetWindowInfo(&info))
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    PushResultTable(L, 1, 4);
+
+        lua_pushinteger(L, info.m_Index);
+        lua_setfield(L, -2, "index");
+
+        lua_pushinteger(L, info.m_FrameCount);
+        lua_setfield(L, -2, "frames");
+
+        lua_pushnumber(L, info.m_Duration / 1000.0);
+        lua_setfield(L, -2, "duration");
+
+    lua_getfield(L, -1, "values");
+    if (!lua_istable(L, -1))
+    {
+        lua_pop(L, 1);
+        lua_createtable(L, 0, 0);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -3, "values");
+    }
+
+    // The paths are built while walking the flattened tree, where each node extends the path of its parent
+    char path[512];
+    uint32_t path_length[g_WindowMaxDepth];
+    path_length[0] = 0;
+
+    const PropertyTreeNode* nodes;
+    uint32_t num_nodes = PropertyGetTree(&nodes);
+    for (uint32_t i = 1; i < num_nodes; ++i) // Skip the root group
+    {
+        uint32_t depth = nodes[i].m_Depth;
+        if (depth >= g_WindowMaxDepth)
+            continue;
+
+        HProperty property = nodes[i].m_Property;
+        uint32_t length = path_length[depth - 1];
+        if (length && length < sizeof(path) - 1)
+            path[length++] = '/';
+        length += dmStrlCpy(path + length, PropertyGetName(property), sizeof(path) - length);
+        if (length > sizeof(path) - 1)
+            length = sizeof(path) - 1;
+        path_length[depth] = length;
+
+        PropertyWindowStats stats;
+        if (PropertyGetType(property) == PROFILE_PROPERTY_TYPE_GROUP)
+            continue;
+        if (!PropertyGetWindowStats(property, &stats))
+        {
+            lua_pushnil(L);
+            lua_setfield(L, -2, path);
+            continue;
+        }
+
+        lua_getfield(L, -1, path);
+        if (!lua_istable(L, -1))
+        {
+            lua_pop(L, 1);
+            lua_createtable(L, 0, 3);
+            lua_pushvalue(L, -1);
+            lua_setfield(L, -3, path);
+        }
+
+            lua_pushnumber(L, stats.m_Sum);
+            lua_setfield(L, -2, "sum");
+
+            lua_pushnumber(L, stats.m_Average);
+            lua_setfield(L, -2, "avg");
+
+            lua_pushnumber(L, stats.m_Max);
+            lua_setfield(L, -2, "max");
+
+        lua_pop(L, 1);
+    }
+
+    lua_pop(L, 1); // values
+    return 1;
+}
+
+static int GetProfileScopes(lua_State* L)
+{
+    uint32_t count = ScopesGetCount();
+    lua_createtable(L, count, 0);
+
+    uint32_t num_scopes = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const ScopeStats* stats = ScopesGetStats(i);
+        if (!stats->m_Count)
+            continue;
+
+        lua_createtable(L, 0, 4);
+
+            lua_pushstring(L, stats->m_Name);
+            lua_setfield(L, -2, "name");
+
+            lua_pushnumber(L, stats->m_TotalTime / 1000.0);
+            lua_setfield(L, -2, "total");
+
+            lua_pushnumber(L, stats->m_SelfTime / 1000.0);
+            lua_setfield(L, -2, "self");
+
+            lua_pushinteger(L, stats->m_Count);
+            lua_setfield(L, -2, "count");
+
+        lua_rawseti(L, -2, ++num_scopes);
+    }
+    return 1;
+}
+
+// The optional parent group argument, the root group if it's nil
+static HProperty CheckParentGroup(lua_State* L, int index)
+{
+    if (lua_isnoneornil(L, index))
+        return PropertyGetRoot();
+
+    HProperty parent = CheckProperty(L, index);
+    if (PropertyGetType(parent) != PROFILE_PROPERTY_TYPE_GROUP)
+        luaL_error(L, "Property '%s' is not a group", lua_tostring(L, index));
+    return parent;
+}
+
+// Returns the path hash of the new property, which can be used with get_value()
+static int PushDerived(lua_State* L, HProperty property, const char* name)
+{
+    if (property == PROFILE_PROPERTY_INVALID_IDX)
+        return luaL_error(L, "Failed to create derived counter '%s'", name);
+    lua_pushnumber(L, PropertyGetPathHash(property));
+    return 1;
+}
+
+// profile.derive_rate(name, source [, parent])
+static int DeriveRate(lua_State* L)
+{
+    const char* name = luaL_checkstring(L, 1);
+    HProperty source = CheckProperty(L, 2);
+    HProperty parent = CheckParentGroup(L, 3);
+    return PushDerived(L, DerivedCreateRate(name, source, parent), name);
+}
+
+// profile.derive_ratio(name, numerator, denominator [, parent])
+static int DeriveRatio(lua_State* L)
+{
+    const char* name = luaL_checkstring(L, 1);
+    HProperty numerator = CheckProperty(L, 2);
+    HProperty denominator = CheckProperty(L, 3);
+    HProperty parent = CheckParentGroup(L, 4);
+    return PushDerived(L, DerivedCreateRatio(name, numerator, denominator, parent), name);
+}
+
+// profile.derive_ema(name, source, alpha [, parent])
+static int DeriveEma(lua_State* L)
+{
+    const char* name = luaL_checkstring(L, 1);
+    HProperty source = CheckProperty(L, 2);
+    double alpha = luaL_checknumber(L, 3);
+    luaL_argcheck(L, alpha > 0.0 && alpha <= 1.0, 3, "alpha must be in (0, 1]");
+    HProperty parent = CheckParentGroup(L, 4);
+    return PushDerived(L, DerivedCreateEma(name, source, alpha, parent), name);
+}
+
+// profile.enable_add_stats(name): returns false if the property is a group or a bool
+static int EnableAddStats(lua_State* L)
+{
+    lua_pushboolean(L, PropertyEnableAddStats(CheckProperty(L, 1)));
+    return 1;
+}
+
+// profile.get_add_stats(name [, table]): returns nil if the add stats aren't enabled for the property
+static int GetAddStats(lua_State* L)
+{
+    PropertyAddStats stats;
+    if (!PropertyGetAddStats(FindProperty(L, 1), &stats))
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    PushResultTable(L, 2, 4);
+    SetAddStatsFields(L, &stats);
+    return 1;
+}
+
+// profile.enable_thread_values(name): returns false if the property is a group
+static int EnableThreadValues(lua_State* L)
+{
+    lua_pushboolean(L, PropertyEnableThreadValues(CheckProperty(L, 1)));
+    return 1;
+}
+
+// profile.get_thread_values(name [, table]): {[thread name] = value} for the threads that wrote to the property last frame
+static int GetThreadValues(lua_State* L)
+{
+    uint32_t threads[THREADS_SLOT_COUNT];
+    double values[THREADS_SLOT_COUNT];
+    uint32_t count = PropertyGetThreadValues(FindProperty(L, 1), threads, values, THREADS_SLOT_COUNT);
+
+    PushResultTable(L, 2, count);
+    SetThreadValuesFields(L, count, threads, values);
+    return 1;
+}
+
+static int StartCapture(lua_State* L)
+{
+    const char* path = luaL_checkstring(L, 1);
+    lua_pushboolean(L, CaptureStart(path));
+    return 1;
+}
+
+static int StopCapture(lua_State* L)
+{
+    CaptureStop();
+    return 0;
+}
+
+// ****************************************************************************
+// Script counters
+
+static const ProfilePropertyType g_CounterTypes[] = {
+    PROFILE_PROPERTY_TYPE_BOOL,
+    PROFILE_PROPERTY_TYPE_S32,
+    PROFILE_PROPERTY_TYPE_U32,
+    PROFILE_PROPERTY_TYPE_F32,
+    PROFILE_PROPERTY_TYPE_S64,
+    PROFILE_PROPERTY_TYPE_U64,
+    PROFILE_PROPERTY_TYPE_F64,
+};
+
+static ProfilePropertyType CheckCounterType(lua_State* L, int index)
+{
+    const char* name = luaL_checkstring(L, index);
+    for (uint32_t i = 0; i < sizeof(g_CounterTypes) / sizeof(g_CounterTypes[0]); ++i)
+    {
+        if (dmStrCaseCmp(name, GetPropertyTypeName(g_CounterTypes[i])) == 0)
+            return g_CounterTypes[i];
+    }
+    luaL_error(L, "Unknown counter type '%s'", name);
+    return PROFILE_PROPERTY_TYPE_GROUP;
+}
+
+// Finds or creates the group or counter at the path. An existing counter is returned if it has the same type
+static HProperty CreateCounterPath(lua_State* L, char* path, ProfilePropertyType type, uint32_t flags)
+{
+    HProperty parent = PropertyGetRoot();
+    char* name = path;
+    for (;;)
+    {
+        char* separator = strchr(name, '/');
+        if (separator)
+            *separator = 0;
+        ProfilePropertyType node_type = separator ? PROFILE_PROPERTY_TYPE_GROUP : type;
+
+        HProperty property = PropertyFindByPath(path);
+        if (property == PROFILE_PROPERTY_INVALID_IDX)
+        {
+            property = PropertyCreate(name, "", node_type, separator ? 0 : flags, parent);
+            if (property == PROFILE_PROPERTY_INVALID_IDX)
+                luaL_error(L, "Failed to create counter '%s'", path);
+        }
+        else if (PropertyGetType(property) != node_type)
+        {
+            luaL_error(L, "Property '%s' already exists with the type %s", path, GetPropertyTypeName(PropertyGetType(property)));
+        }
+
+        if (!separator)
+            return property;
+        *separator = '/';
+        name = separator + 1;
+        parent = property;
+    }
+}
+
+// profile.create_counter(path, type [, flags]): the missing groups in the path (e.g. "Gameplay/Enemies") are created too.
+// Returns a handle for add(), set() and the other functions that take a property
+static int CreateCounter(lua_State* L)
+{
+    char path[256];
+    const char* arg = luaL_checkstring(L, 1);
+    luaL_argcheck(L, arg[0] && dmStrlCpy(path, arg, sizeof(path)) < sizeof(path), 1, "invalid path");
+    ProfilePropertyType type = CheckCounterType(L, 2);
+    uint32_t flags = (uint32_t)luaL_optinteger(L, 3, PROFILE_PROPERTY_NONE);
+
+    HProperty property = CreateCounterPath(L, path, type, flags);
+    lua_pushlightuserdata(L, (void*)(uintptr_t)(property + 1));
+    return 1;
+}
+
+static HProperty CheckCounter(lua_State* L, int index)
+{
+    luaL_checktype(L, index, LUA_TLIGHTUSERDATA);
+    return ToCounter(L, index);
+}
+
+// profile.add(counter, value)
+static int AddCounter(lua_State* L)
+{
+    HProperty property = CheckCounter(L, 1);
+    PropertyAddNumber(property, luaL_checknumber(L, 2));
+    return 0;
+}
+
+// profile.set(counter, value): value is a number, or a boolean for bool counters
+static int SetCounter(lua_State* L)
+{
+    HProperty property = CheckCounter(L, 1);
+    double value = lua_isboolean(L, 2) ? (lua_toboolean(L, 2) ? 1.0 : 0.0) : luaL_checknumber(L, 2);
+    PropertySetNumber(property, value);
+    return 0;
+}
+
+// ****************************************************************************
+// Baselines
+
+static void PushBaselineStats(lua_State* L, const BaselineStats* stats)
+{
+    lua_pushnumber(L, stats->m_Mean);
+    lua_setfield(L, -2, "mean");
+
+    lua_pushnumber(L, stats->m_Max);
+    lua_setfield(L, -2, "max");
+
+    lua_pushnumber(L, stats->m_P95);
+    lua_setfield(L, -2, "p95");
+}
+
+// profile.save_baseline(name [, path]): records the stats over the history, and writes them to the file if a path is given.
+// Returns false if the history is disabled, or if the file couldn't be written
+static int SaveBaseline(lua_State* L)
+{
+    const char* name = luaL_checkstring(L, 1);
+    const char* path = luaL_optstring(L, 2, 0);
+    bool result = BaselineSave(name) && (!path || BaselineWrite(name, path));
+    lua_pushboolean(L, result);
+    return 1;
+}
+
+// profile.load_baseline(name, path)
+static int LoadBaseline(lua_State* L)
+{
+    const char* name = luaL_checkstring(L, 1);
+    const char* path = luaL_checkstring(L, 2);
+    lua_pushboolean(L, BaselineRead(name, path));
+    return 1;
+}
+
+// profile.compare(name [, threshold]): {[path] = {mean, max, p95, change, baseline = {mean, max, p95}}} for the properties
+// whose mean or p95 changed by more than the threshold (default 0.1). Returns nil if there's no such baseline, or no history
+static int CompareBaseline(lua_State* L)
+{
+    const char* name = luaL_checkstring(L, 1);
+    double threshold = luaL_optnumber(L, 2, 0.1);
+
+    const BaselineChange* changes;
+    uint32_t count;
+    if (!BaselineCompare(name, threshold, &changes, &count))
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    char path[256];
+    lua_createtable(L, 0, count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const BaselineChange* change = &changes[i];
+        lua_createtable(L, 0, 5);
+
+            PushBaselineStats(L, &change->m_Current);
+
+            lua_pushnumber(L, change->m_Change);
+            lua_setfield(L, -2, "change");
+
+            lua_createtable(L, 0, 3);
+            PushBaselineStats(L, &change->m_Baseline);
+            lua_setfield(L, -2, "baseline");
+
+        PropertyGetPath(change->m_Property, path, sizeof(path));
+        lua_setfield(L, -2, path);
+    }
+    return 1;
+}
+
+// ****************************************************************************
+// Log
+
+static dmArray<LogTextEntry> g_LogTextEntries;
+
+// profile.get_frame(): the number of the last published frame, as used by get_log() and the triggers
+static int GetFrame(lua_State* L)
+{
+    lua_pushinteger(L, PropertyGetFrame());
+    return 1;
+}
+
+// profile.get_log([first_frame [, last_frame]]): {{frame, thread, text}, ...} for the LogText markers still in the buffer, oldest first
+static int GetLog(lua_State* L)
+{
+    uint32_t first_frame = (uint32_t)luaL_optinteger(L, 1, 0);
+    uint32_t last_frame = lua_isnoneornil(L, 2) ? 0xFFFFFFFF : (uint32_t)luaL_checkinteger(L, 2);
+
+    uint32_t capacity = LogTextGetCapacity();
+    if (g_LogTextEntries.Capacity() < capacity)
+        g_LogTextEntries.SetCapacity(capacity);
+    g_LogTextEntries.SetSize(capacity);
+    uint32_t count = LogTextGet(first_frame, last_frame, g_LogTextEntries.Begin(), capacity);
+
+    lua_createtable(L, count, 0);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const LogTextEntry* entry = &g_LogTextEntries[i];
+        lua_createtable(L, 0, 3);
+
+            lua_pushinteger(L, entry->m_Frame);
+            lua_setfield(L, -2, "frame");
+
+            lua_pushstring(L, ThreadsGetNameById(entry->m_Thread));
+            lua_setfield(L, -2, "thread");
+
+            lua_pushstring(L, entry->m_Text);
+            lua_setfield(L, -2, "text");
+
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+// ****************************************************************************
+// Triggers
+
+static dmArray<uint32_t>            g_ScriptTriggers;           // The triggers with a Lua callback
+static dmScript::LuaCallbackInfo*   g_InvokingCallback = 0;
+static bool                         g_DestroyInvokingCallback = false;
+static dmArray<double>              g_TriggerHistory;
+
+static void PushTriggerEvent(lua_State* L, void* ctx)
+{
+    const TriggerEvent* event = (const TriggerEvent*)ctx;
+    char path[256];
+
+    lua_createtable(L, 0, 7);
+
+        lua_pushinteger(L, event->m_Id);
+        lua_setfield(L, -2, "id");
+
+        PropertyGetPath(event->m_Property, path, sizeof(path));
+        lua_pushstring(L, path);
+        lua_setfield(L, -2, "property");
+
+        lua_pushnumber(L, event->m_Value);
+        lua_setfield(L, -2, "value");
+
+        lua_pushnumber(L, event->m_Threshold);
+        lua_setfield(L, -2, "threshold");
+
+        lua_pushinteger(L, event->m_Frame);
+        lua_setfield(L, -2, "frame");
+
+        if (event->m_DumpPath)
+        {
+            lua_pushstring(L, event->m_DumpPath);
+            lua_setfield(L, -2, "dump");
+        }
+
+    // The history of all properties, oldest frame first
+    uint32_t num_frames = PropertyGetHistorySize();
+    if (!num_frames)
+        return;
+
+    if (g_TriggerHistory.Capacity() < num_frames)
+        g_TriggerHistory.SetCapacity(num_frames);
+    g_TriggerHistory.SetSize(num_frames);
+
+    lua_createtable(L, 0, 0);
+    const PropertyTreeNode* nodes;
+    uint32_t num_nodes = PropertyGetTree(&nodes);
+    for (uint32_t i = 0; i < num_nodes; ++i)
+    {
+        HProperty property = nodes[i].m_Property;
+        uint32_t count = PropertyGetHistory(property, g_TriggerHistory.Begin(), num_frames);
+        if (!count)
+            continue;
+
+        lua_createtable(L, count, 0);
+        for (uint32_t f = 0; f < count; ++f)
+        {
+            lua_pushnumber(L, g_TriggerHistory[f]);
+            lua_rawseti(L, -2, f + 1);
+        }
+        PropertyGetPath(property, path, sizeof(path));
+        lua_setfield(L, -2, path);
+    }
+    lua_setfield(L, -2, "history");
+}
+
+static void TriggerLuaCallback(const TriggerEvent* event, void* ctx)
+{
+    dmScript::LuaCallbackInfo* callback = (dmScript::LuaCallbackInfo*)ctx;
+    if (!dmScript::IsCallbackValid(callback))
+        return;
+
+    g_InvokingCallback = callback;
+    g_DestroyInvokingCallback = false;
+    dmScript::InvokeCallback(callback, PushTriggerEvent, (void*)event);
+    g_InvokingCallback = 0;
+
+    // The callback removed its own trigger
+    if (g_DestroyInvokingCallback)
+        dmScript::DestroyCallback(callback);
+}
+
+static void RemoveScriptTrigger(uint32_t id)
+{
+    void* ctx = 0;
+    if (!TriggerRemove(id, &ctx))
+        return;
+
+    for (uint32_t i = 0; i < g_ScriptTriggers.Size(); ++i)
+    {
+        if (g_ScriptTriggers[i] == id)
+        {
+            g_ScriptTriggers.EraseSwap(i);
+            break;
+        }
+    }
+
+    dmScript::LuaCallbackInfo* callback = (dmScript::LuaCallbackInfo*)ctx;
+    if (!callback)
+        return;
+    if (callback == g_InvokingCallback)
+        g_DestroyInvokingCallback = true;
+    else
+        dmScript::DestroyCallback(callback);
+}
+
+static TriggerOp CheckTriggerOp(lua_State* L, int index)
+{
+    const char* op = luaL_checkstring(L, index);
+    if (strcmp(op, ">") == 0)   return TRIGGER_OP_GT;
+    if (strcmp(op, ">=") == 0)  return TRIGGER_OP_GE;
+    if (strcmp(op, "<") == 0)   return TRIGGER_OP_LT;
+    if (strcmp(op, "<=") == 0)  return TRIGGER_OP_LE;
+    luaL_argerror(L, index, "expected one of '>', '>=', '<', '<='");
+    return TRIGGER_OP_GT;
+}
+
+// profile.add_trigger(property, op, threshold [, {dump = prefix, callback = function(self, event) end}])
+// Returns the id of the trigger
+static int AddTrigger(lua_State* L)
+{
+    HProperty property = CheckProperty(L, 1);
+    TriggerOp op = CheckTriggerOp(L, 2);
+    double threshold = luaL_checknumber(L, 3);
+
+    const char* dump_prefix = 0;
+    dmScript::LuaCallbackInfo* callback = 0;
+    if (lua_istable(L, 4))
+    {
+        lua_getfield(L, 4, "dump");
+        dump_prefix = lua_isnil(L, -1) ? 0 : luaL_checkstring(L, -1);
+
+        lua_getfield(L, 4, "callback");
+        if (lua_isfunction(L, -1))
+            callback = dmScript::CreateCallback(L, -1);
+        lua_pop(L, 2);
+    }
+
+    uint32_t id = TriggerCreate(property, op, threshold, dump_prefix, callback ? TriggerLuaCallback : 0, callback);
+    if (!id)
+    {
+        if (callback)
+            dmScript::DestroyCallback(callback);
+        return luaL_error(L, "Failed to add a trigger to '%s'", lua_tostring(L, 1));
+    }
+
+    if (callback)
+    {
+        if (g_ScriptTriggers.Full())
+            g_ScriptTriggers.OffsetCapacity(16);
+        g_ScriptTriggers.Push(id);
+    }
+    lua_pushinteger(L, id);
+    return 1;
+}
+
+// profile.remove_trigger(id)
+static int RemoveTrigger(lua_State* L)
+{
+    RemoveScriptTrigger((uint32_t)luaL_checkinteger(L, 1));
+    return 0;
+}
+
 // Functions exposed to Lua
 static const luaL_reg Module_methods[] =
 {
+    {"add", AddCounter},
+    {"add_trigger", AddTrigger},
+    {"compare", CompareBaseline},
+    {"create_counter", CreateCounter},
+    {"derive_ema", DeriveEma},
+    {"derive_rate", DeriveRate},
+    {"derive_ratio", DeriveRatio},
+    {"enable_add_stats", EnableAddStats},
+    {"enable_thread_values", EnableThreadValues},
+    {"get_add_stats", GetAddStats},
+    {"get_frame", GetFrame},
+    {"get_log", GetLog},
     {"get_properties", GetProfileProperties},
+    {"get_scopes", GetProfileScopes},
+    {"get_snapshot", GetProfileSnapshot},
+    {"get_stats", GetProfileStats},
+    {"get_thread_values", GetThreadValues},
+    {"get_value", GetProfileValue},
+    {"get_values", GetProfileValues},
+    {"get_window", GetProfileWindow},
+    {"load_baseline", LoadBaseline},
+    {"remove_trigger", RemoveTrigger},
+    {"save_baseline", SaveBaseline},
+    {"set", SetCounter},
+    {"start_capture", StartCapture},
+    {"stop_capture", StopCapture},
     {0, 0}
 };
 
@@ -131,9 +1258,29 @@ void ScriptInit(lua_State* L)
 {
     int top = lua_gettop(L);
 
+    // Any cached tree belongs to the previous Lua state
+    g_CachedTreeRef = LUA_NOREF;
+    g_CachedNodesRef = LUA_NOREF;
+    g_CachedNodes.SetSize(0);
+    g_SnapshotRef = LUA_NOREF;
+
+    luaL_newmetatable(L, SNAPSHOT_TYPE_NAME);
+    luaL_register(L, 0, Snapshot_methods);
+    lua_pop(L, 1);
+
     // Register lua names
     luaL_register(L, MODULE_NAME, Module_methods);
 
+    lua_pushinteger(L, PROFILE_PROPERTY_FRAME_RESET);
+    lua_setfield(L, -2, "FRAME_RESET");
+
     lua_pop(L, 1);
     assert(top == lua_gettop(L));
 }
+
+void ScriptFinalize(lua_State* L)
+{
+    // The callbacks belong to this Lua state
+    while (!g_ScriptTriggers.Empty())
+        RemoveScriptTrigger(g_ScriptTriggers.Back());
+}
@@ -2,5 +2,6 @@
 #define DM_SCRIPT_H
 
 void ScriptInit(struct lua_State* L);
+void ScriptFinalize(struct lua_State* L);
 
 #endif // DM_SCRIPT_H
@@ -0,0 +1,149 @@
+#if defined(PROFILER_SELF_STATS)
+
+#include <atomic>
+
+#include "profiler.h"
+#include "selfstats.h"
+#include "sharded.h"
+
+enum SelfStatsProperty
+{
+    SELF_STATS_SET_CALLS,
+    SELF_STATS_ADD_CALLS,
+    SELF_STATS_LOCK_COUNT,
+    SELF_STATS_LOCK_WAIT,
+    SELF_STATS_RESET_TIME,
+    SELF_STATS_FRAME_END_TIME,
+    SELF_STATS_EXPORT_TIME,
+    SELF_STATS_EXPORT_NODES,
+    SELF_STATS_DROPPED,
+    SELF_STATS_PROPERTY_COUNT,
+};
+
+struct SelfStatsPropertyDesc
+{
+    const char*         m_Name;
+    const char*         m_Desc;
+    ProfilePropertyType m_Type;
+};
+
+static const SelfStatsPropertyDesc g_SelfStatsDescs[SELF_STATS_PROPERTY_COUNT] = {
+    {"SetCalls",           "Set calls during the frame",                                      PROFILE_PROPERTY_TYPE_U32},
+    {"AddCalls",           "Add calls during the frame",                                      PROFILE_PROPERTY_TYPE_U32},
+    {"LockCount",          "Acquisitions of the property lock during the frame",              PROFILE_PROPERTY_TYPE_U32},
+    {"LockWait",           "Time spent waiting for the property lock during the frame (ms)",  PROFILE_PROPERTY_TYPE_F64},
+    {"ResetTime",          "Time spent publishing the values at the frame end (ms)",          PROFILE_PROPERTY_TYPE_F64},
+    {"FrameEndTime",       "Time spent in the previous frame end (ms)",                       PROFILE_PROPERTY_TYPE_F64},
+    {"ExportTime",         "Time of the last get_properties() call (ms)",                     PROFILE_PROPERTY_TYPE_F64},
+    {"ExportNodes",        "Number of nodes in the last get_properties() call",               PROFILE_PROPERTY_TYPE_U32},
+    {"DroppedProperties",  "Properties that didn't fit in profiler_counter.max_properties",   PROFILE_PROPERTY_TYPE_U32},
+};
+
+static HProperty                g_SelfStatsProperties[SELF_STATS_PROPERTY_COUNT];
+static bool                     g_SelfStatsRegistered = false;
+
+// Spread over cache lines, so that the threads calling Set and Add don't all write to the same one
+static ShardedCounter           g_SelfStatsSetCalls;
+static ShardedCounter           g_SelfStatsAddCalls;
+static ShardedCounter           g_SelfStatsLockCount;
+static ShardedCounter           g_SelfStatsLockWait;    // Microseconds
+static std::atomic<uint32_t>    g_SelfStatsDropped;     // Since the start
+
+static uint64_t                 g_SelfStatsResetTime = 0;
+static uint64_t                 g_SelfStatsFrameEndTime = 0;
+static uint64_t                 g_SelfStatsExportTime = 0;
+static uint32_t                 g_SelfStatsExportNodes = 0;
+
+void SelfStatsInitialize()
+{
+    ShardedExchange(&g_SelfStatsSetCalls);
+    ShardedExchange(&g_SelfStatsAddCalls);
+    ShardedExchange(&g_SelfStatsLockCount);
+    ShardedExchange(&g_SelfStatsLockWait);
+
+    for (uint32_t i = 0; i < SELF_STATS_PROPERTY_COUNT; ++i)
+        g_SelfStatsProperties[i] = PROFILE_PROPERTY_INVALID_IDX;
+    g_SelfStatsRegistered = false;
+}
+
+void SelfStatsRegister()
+{
+    if (g_SelfStatsRegistered)
+        return;
+    g_SelfStatsRegistered = true;
+
+    HProperty group = PropertyCreate("ProfilerCounter", "The costs of the profiler extension", PROFILE_PROPERTY_TYPE_GROUP, 0, PropertyGetRoot());
+    for (uint32_t i = 0; i < SELF_STATS_PROPERTY_COUNT; ++i)
+    {
+        const SelfStatsPropertyDesc* desc = &g_SelfStatsDescs[i];
+        g_SelfStatsProperties[i] = group == PROFILE_PROPERTY_INVALID_IDX ? group : PropertyCreate(desc->m_Name, desc->m_Desc, desc->m_Type, 0, group);
+    }
+}
+
+void SelfStatsCountSet()
+{
+    ShardedAdd(&g_SelfStatsSetCalls, 1);
+}
+
+void SelfStatsCountAdd()
+{
+    ShardedAdd(&g_SelfStatsAddCalls, 1);
+}
+
+void SelfStatsCountLock(uint64_t wait_time)
+{
+    ShardedAdd(&g_SelfStatsLockCount, 1);
+    if (wait_time)
+        ShardedAdd(&g_SelfStatsLockWait, wait_time);
+}
+
+void SelfStatsCountDropped()
+{
+    g_SelfStatsDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SelfStatsSetResetTime(uint64_t time)
+{
+    g_SelfStatsResetTime = time;
+}
+
+void SelfStatsSetFrameEndTime(uint64_t time)
+{
+    g_SelfStatsFrameEndTime = time;
+}
+
+void SelfStatsSetExport(uint64_t time, uint32_t num_nodes)
+{
+    g_SelfStatsExportTime = time;
+    g_SelfStatsExportNodes = num_nodes;
+}
+
+static void SetValue(SelfStatsProperty property, uint32_t u32, double f64)
+{
+    HProperty hproperty = g_SelfStatsProperties[property];
+    if (hproperty == PROFILE_PROPERTY_INVALID_IDX)
+        return;
+
+    ProfilePropertyValue value;
+    value.m_U64 = 0;
+    if (g_SelfStatsDescs[property].m_Type == PROFILE_PROPERTY_TYPE_U32)
+        value.m_U32 = u32;
+    else
+        value.m_F64 = f64;
+    PropertySetFrameValue(hproperty, value);
+}
+
+void SelfStatsFrameEnd()
+{
+    SetValue(SELF_STATS_SET_CALLS, (uint32_t)ShardedExchange(&g_SelfStatsSetCalls), 0.0);
+    SetValue(SELF_STATS_ADD_CALLS, (uint32_t)ShardedExchange(&g_SelfStatsAddCalls), 0.0);
+    SetValue(SELF_STATS_LOCK_COUNT, (uint32_t)ShardedExchange(&g_SelfStatsLockCount), 0.0);
+    SetValue(SELF_STATS_LOCK_WAIT, 0, ShardedExchange(&g_SelfStatsLockWait) / 1000.0);
+    SetValue(SELF_STATS_RESET_TIME, 0, g_SelfStatsResetTime / 1000.0);
+    SetValue(SELF_STATS_FRAME_END_TIME, 0, g_SelfStatsFrameEndTime / 1000.0);
+    SetValue(SELF_STATS_EXPORT_TIME, 0, g_SelfStatsExportTime / 1000.0);
+    SetValue(SELF_STATS_EXPORT_NODES, g_SelfStatsExportNodes, 0.0);
+    SetValue(SELF_STATS_DROPPED, g_SelfStatsDropped.load(std::memory_order_relaxed), 0.0);
+}
+
+#endif // PROFILER_SELF_STATS
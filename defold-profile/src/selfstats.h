@@ -0,0 +1,39 @@
+#ifndef DM_PROFILER_SELFSTATS_H
+#define DM_PROFILER_SELFSTATS_H
+
+#include <stdint.h>
+
+// The extension's own costs, reported as properties in the "ProfilerCounter" group.
+// Only built with the PROFILER_SELF_STATS define, otherwise SELF_STATS() compiles to nothing.
+
+#if defined(PROFILER_SELF_STATS)
+
+#define SELF_STATS(STATEMENT) STATEMENT
+
+void    SelfStatsInitialize();
+// Called from FrameEnd, before taking the property lock. The properties are registered in the first frame,
+// so they are listed after the engine properties that are registered at startup
+void    SelfStatsRegister();
+
+// May be called from any thread
+void    SelfStatsCountSet();
+void    SelfStatsCountAdd();
+void    SelfStatsCountLock(uint64_t wait_time);
+void    SelfStatsCountDropped();
+
+// Main thread only
+void    SelfStatsSetResetTime(uint64_t time);
+void    SelfStatsSetFrameEndTime(uint64_t time);
+void    SelfStatsSetExport(uint64_t time, uint32_t num_nodes);
+
+// Called from FrameEnd, after the frame has been published. Writes the counts of the frame, the reset time of this
+// frame end, and the total time of the previous one
+void    SelfStatsFrameEnd();
+
+#else
+
+#define SELF_STATS(STATEMENT)
+
+#endif
+
+#endif // DM_PROFILER_SELFSTATS_H
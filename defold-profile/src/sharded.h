@@ -0,0 +1,75 @@
+#ifndef DM_PROFILER_SHARDED_H
+#define DM_PROFILER_SHARDED_H
+
+#include <dmsdk/dlib/time.h>
+
+#include <atomic>
+#include <stdint.h>
+
+// A counter spread over cache lines, so the threads that update it rarely write to the same line.
+// A thread picks its line from the address of its stack, which is far apart for different threads.
+//
+// It's also used to count the calls from other threads that are in flight: the caller enters, and then checks
+// that the module is still initialized. The module is finalized by first marking it as such, and then waiting
+// for the count to drop to zero, before freeing what the callers use.
+
+static const uint32_t   SHARDED_LINE_COUNT = 16;
+static const uint32_t   SHARDED_LINE_SIZE = 64;
+
+struct ShardedLine
+{
+    std::atomic<uint64_t>   m_Value;
+    uint8_t                 m_Pad[SHARDED_LINE_SIZE - sizeof(uint64_t)];
+};
+
+struct ShardedCounter
+{
+    ShardedLine m_Lines[SHARDED_LINE_COUNT];
+};
+
+// The line of the calling thread. The same thread may get another line from a different call depth
+static inline uint32_t ShardedGetLine()
+{
+    uint8_t marker;
+    uint32_t page = (uint32_t)((uintptr_t)&marker >> 12);
+    return (page * 2654435761u) >> 28; // Fibonacci hashing, the top 4 bits
+}
+
+static inline void ShardedAdd(ShardedCounter* counter, uint64_t value)
+{
+    counter->m_Lines[ShardedGetLine()].m_Value.fetch_add(value, std::memory_order_relaxed);
+}
+
+// Returns the sum, and resets the counter. An add that races with it ends up in the next sum
+static inline uint64_t ShardedExchange(ShardedCounter* counter)
+{
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < SHARDED_LINE_COUNT; ++i)
+        sum += counter->m_Lines[i].m_Value.exchange(0, std::memory_order_relaxed);
+    return sum;
+}
+
+// Returns the line to pass to ShardedLeave
+static inline uint32_t ShardedEnter(ShardedCounter* counter)
+{
+    uint32_t line = ShardedGetLine();
+    counter->m_Lines[line].m_Value.fetch_add(1);
+    return line;
+}
+
+static inline void ShardedLeave(ShardedCounter* counter, uint32_t line)
+{
+    counter->m_Lines[line].m_Value.fetch_sub(1, std::memory_order_release);
+}
+
+// Waits for the callers that entered to leave
+static inline void ShardedDrain(ShardedCounter* counter)
+{
+    for (uint32_t i = 0; i < SHARDED_LINE_COUNT; ++i)
+    {
+        while (counter->m_Lines[i].m_Value.load())
+            dmTime::Sleep(100);
+    }
+}
+
+#endif // DM_PROFILER_SHARDED_H
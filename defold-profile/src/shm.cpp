@@ -0,0 +1,193 @@
+#include <dmsdk/dlib/dstrings.h>
+#include <dmsdk/dlib/log.h>
+#include <dmsdk/dlib/time.h>
+
+#include <string.h>
+
+#include "profiler.h"
+#include "shm.h"
+#include "shm_format.h"
+
+#if defined(__linux__)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint32_t   g_ShmMaxCapacity = 65536;
+
+static ShmHeader*       g_ShmHeader = 0;
+static uint32_t         g_ShmSize = 0;
+static char             g_ShmName[128];
+
+// The slot of the property (see shm_format.h), or the capacity if it isn't in the segment
+static uint32_t GetSlot(const ShmHeader* header, HProperty property)
+{
+    if (property < header->m_Count)
+        return property;
+    uint32_t extension_index = property - PropertyGetExtensionFirst();
+    if (property >= PropertyGetExtensionFirst() && extension_index < header->m_ExtensionCount)
+        return header->m_Capacity - 1 - extension_index;
+    return header->m_Capacity;
+}
+
+static void WriteValue(ShmHeader* header, HProperty property)
+{
+    uint32_t slot = GetSlot(header, property);
+    if (slot >= header->m_Capacity)
+        return;
+    ProfilePropertyValue value = PropertyGetPrevValue(property);
+    memcpy(&ShmGetValues(header)[slot], &value, sizeof(uint64_t));
+}
+
+// Writes the value, and the property itself if it isn't in its slot yet
+static void WriteProperty(ShmHeader* header, HProperty property)
+{
+    if (!PropertyIsPublished(property))
+        return;
+    WriteValue(header, property);
+
+    ShmProperty* shm_property = &ShmGetProperties(header)[GetSlot(header, property)];
+    if (shm_property->m_Valid)
+        return;
+
+    uint32_t parent = GetSlot(header, PropertyGetParent(property));
+    shm_property->m_Parent      = parent < header->m_Capacity ? parent + 1 : 0;
+    shm_property->m_Type        = (uint8_t)PropertyGetType(property);
+    shm_property->m_Flags       = PropertyGetFlags(property);
+    shm_property->m_NameHash    = PropertyGetNameHash(property);
+    PropertyGetPath(property, shm_property->m_Path, sizeof(shm_property->m_Path));
+    shm_property->m_Valid       = 1;
+}
+
+void ShmFrameEnd()
+{
+    ShmHeader* header = g_ShmHeader;
+    if (!header)
+        return;
+
+    uint32_t sequence = header->m_Sequence.load(std::memory_order_relaxed);
+    header->m_Sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint32_t generation = PropertyGetTreeGeneration();
+    if (generation != header->m_Generation)
+    {
+        // The extension properties get their slots first, the engine properties fill the rest from the bottom
+        uint32_t capacity = header->m_Capacity;
+        uint32_t extension_count = PropertyGetExtensionCount();
+        if (extension_count > capacity)
+            extension_count = capacity;
+        uint32_t count = PropertyGetCount();
+        if (count > capacity - extension_count)
+            count = capacity - extension_count;
+
+        // The new extension slots may hold engine properties that don't fit anymore
+        ShmProperty* properties = ShmGetProperties(header);
+        for (uint32_t slot = capacity - extension_count; slot < capacity - header->m_ExtensionCount; ++slot)
+            properties[slot].m_Valid = 0;
+        header->m_Count = count;
+        header->m_ExtensionCount = extension_count;
+
+        // Rare, so we write all values, instead of keeping track of which properties are new
+        HProperty extension_first = PropertyGetExtensionFirst();
+        for (HProperty i = 0; i < count; ++i)
+            WriteProperty(header, i);
+        for (HProperty i = extension_first; i < extension_first + extension_count; ++i)
+            WriteProperty(header, i);
+        header->m_Generation = generation;
+    }
+    else
+    {
+        const HProperty* changed;
+        uint32_t num_changed = PropertyGetChanged(&changed);
+        for (uint32_t i = 0; i < num_changed; ++i)
+            WriteValue(header, changed[i]);
+    }
+
+    header->m_Frame = PropertyGetFrame();
+    header->m_Time  = dmTime::GetTime();
+
+    header->m_Sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool ShmStart(const char* name, uint32_t capacity)
+{
+    ShmStop();
+
+    if (capacity > g_ShmMaxCapacity)
+        capacity = g_ShmMaxCapacity;
+
+    // POSIX requires the name to start with a slash
+    g_ShmName[0] = 0;
+    if (name[0] != '/')
+        dmStrlCpy(g_ShmName, "/", sizeof(g_ShmName));
+    dmStrlCat(g_ShmName, name, sizeof(g_ShmName));
+
+    int fd = shm_open(g_ShmName, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        dmLogError("Failed to open shared memory '%s'", g_ShmName);
+        return false;
+    }
+
+    uint32_t size = ShmGetSize(capacity);
+    void* memory = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (memory == MAP_FAILED)
+    {
+        dmLogError("Failed to map %u bytes of shared memory '%s'", size, g_ShmName);
+        shm_unlink(g_ShmName);
+        return false;
+    }
+
+    memset(memory, 0, size);
+    ShmHeader* header = (ShmHeader*)memory;
+    header->m_Version       = SHM_VERSION;
+    header->m_Capacity      = capacity;
+    header->m_HeaderSize    = sizeof(ShmHeader);
+    header->m_Generation    = PropertyGetTreeGeneration() - 1; // Make sure the properties are written
+    header->m_Sequence.store(0, std::memory_order_relaxed);
+
+    // The magic is written last, so a reader never sees a half initialized header
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->m_Magic, SHM_MAGIC, sizeof(SHM_MAGIC));
+
+    g_ShmHeader = header;
+    g_ShmSize = size;
+    dmLogInfo("Publishing %u properties to shared memory '%s'", capacity, g_ShmName);
+    return true;
+}
+
+void ShmStop()
+{
+    if (!g_ShmHeader)
+        return;
+
+    munmap(g_ShmHeader, g_ShmSize);
+    shm_unlink(g_ShmName);
+    g_ShmHeader = 0;
+    g_ShmSize = 0;
+}
+
+#else
+
+bool ShmStart(const char* name, uint32_t capacity)
+{
+    dmLogWarning("Shared memory export is not supported on this platform");
+    return false;
+}
+
+void ShmStop()
+{
+}
+
+void ShmFrameEnd()
+{
+}
+
+#endif
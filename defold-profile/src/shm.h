@@ -0,0 +1,16 @@
+#ifndef DM_PROFILER_SHM_H
+#define DM_PROFILER_SHM_H
+
+#include <stdint.h>
+
+// Publishes the property table and the values of the last frame into a named shared memory segment (see shm_format.h),
+// so that other processes on the same machine can monitor the counters.
+// Only supported on Linux, the functions do nothing on the other platforms.
+
+bool    ShmStart(const char* name, uint32_t capacity);
+void    ShmStop();
+
+// Called from FrameEnd, after the frame has been published
+void    ShmFrameEnd();
+
+#endif // DM_PROFILER_SHM_H
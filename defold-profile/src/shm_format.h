@@ -0,0 +1,67 @@
+#ifndef DM_PROFILER_SHM_FORMAT_H
+#define DM_PROFILER_SHM_FORMAT_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Layout of the shared memory segment with the live property values.
+// Shared with the reader in tools/, so it must not depend on dmsdk.
+//
+// The segment is only read on the same machine, so everything uses the native byte order:
+//
+//   ShmHeader
+//   ShmProperty[m_Capacity]    indexed by the slot
+//   uint64_t[m_Capacity]       the value of each property (the bits of a ProfilePropertyValue)
+//
+// The engine properties are in the slots [0, m_Count), at their property index. The properties owned by the extension
+// (e.g. derived counters) are in the last m_ExtensionCount slots, from the top down: the first one is in slot m_Capacity - 1.
+//
+// Everything after m_Sequence is protected by it (a seqlock). The writer makes it odd while it updates the segment,
+// so a reader copies what it needs, and retries if the sequence was odd or changed in the meantime.
+
+static const uint8_t    SHM_MAGIC[4] = { 'D', 'P', 'S', 'M' };
+static const uint32_t   SHM_VERSION = 2;
+static const uint32_t   SHM_PATH_LENGTH = 112;
+
+struct ShmHeader
+{
+    uint8_t                 m_Magic[4];
+    uint32_t                m_Version;
+    uint32_t                m_Capacity;     // Max number of properties
+    uint32_t                m_HeaderSize;   // sizeof(ShmHeader)
+    std::atomic<uint32_t>   m_Sequence;
+
+    uint32_t                m_Count;        // One past the highest engine property index in the segment
+    uint32_t                m_ExtensionCount;
+    uint32_t                m_Generation;   // Changes when a property is added
+    uint32_t                m_Frame;
+    uint64_t                m_Time;         // Microseconds
+};
+
+struct ShmProperty
+{
+    uint32_t    m_Parent;   // Slot + 1, 0 = no parent (or the parent isn't in the segment)
+    uint8_t     m_Type;     // ProfilePropertyType
+    uint8_t     m_Valid;    // 0 = no property in this slot
+    uint16_t    m_Pad;
+    uint32_t    m_Flags;
+    uint32_t    m_NameHash;
+    char        m_Path[SHM_PATH_LENGTH]; // e.g. "Physics/Contacts", excluding the root group
+};
+
+static inline uint32_t ShmGetSize(uint32_t capacity)
+{
+    return (uint32_t)(sizeof(ShmHeader) + capacity * (sizeof(ShmProperty) + sizeof(uint64_t)));
+}
+
+static inline ShmProperty* ShmGetProperties(ShmHeader* header)
+{
+    return (ShmProperty*)(header + 1);
+}
+
+static inline uint64_t* ShmGetValues(ShmHeader* header)
+{
+    return (uint64_t*)(ShmGetProperties(header) + header->m_Capacity);
+}
+
+#endif // DM_PROFILER_SHM_FORMAT_H
@@ -0,0 +1,153 @@
+#include <dmsdk/dlib/dstrings.h>
+#include <dmsdk/dlib/log.h>
+#include <dmsdk/dlib/thread.h>
+
+#include <atomic>
+#include <stdint.h>
+
+#include "sharded.h"
+#include "threads.h"
+
+static const uint32_t           g_ThreadNameLength = 32;
+static const uint32_t           g_ThreadIdOther = THREADS_ID_MAX - 1;
+
+// The tls value holds the value slot + 1 in the low 8 bits, and the id + 1 in the next 9 bits, since the tls value is 0 until it's set.
+// Above them is the generation the value was set in, so that a value left over from an earlier listener is ignored if the key is reused
+static const uintptr_t          g_ThreadSlotMask = 0xFF;
+static const uint32_t           g_ThreadIdShift = 8;
+static const uintptr_t          g_ThreadIdMask = 0x1FF;
+static const uint32_t           g_ThreadGenerationShift = 17;
+static const uint32_t           g_ThreadGenerationMask = 0x7FFF;
+
+static dmThread::TlsKey         g_ThreadKey;
+static std::atomic<bool>        g_ThreadsInitialized(false);
+static uint32_t                 g_ThreadGeneration = 0;
+static ShardedCounter           g_ThreadWriters; // Threads inside the functions that use the tls key
+static std::atomic<uint32_t>    g_ThreadIdCount(0);
+static std::atomic<uint32_t>    g_ThreadSlotCount(0);
+static char                     g_ThreadNames[THREADS_ID_MAX][g_ThreadNameLength]; // Written by the owning thread
+static uint32_t                 g_ThreadSlotIds[THREADS_SLOT_COUNT];                // Written by the owning thread
+
+static uintptr_t GetThreadValue()
+{
+    uintptr_t value = (uintptr_t)dmThread::GetTlsValue(g_ThreadKey);
+    return (value >> g_ThreadGenerationShift) == g_ThreadGeneration ? value : 0;
+}
+
+static void SetThreadValue(uintptr_t value)
+{
+    value |= (uintptr_t)g_ThreadGeneration << g_ThreadGenerationShift;
+    dmThread::SetTlsValue(g_ThreadKey, (void*)value);
+}
+
+static uint32_t GetThreadId()
+{
+    uintptr_t value = GetThreadValue();
+    if ((value >> g_ThreadIdShift) & g_ThreadIdMask)
+        return (uint32_t)((value >> g_ThreadIdShift) & g_ThreadIdMask) - 1;
+
+    uint32_t id = g_ThreadIdCount.fetch_add(1, std::memory_order_relaxed);
+    if (id >= g_ThreadIdOther)
+    {
+        if (id == g_ThreadIdOther)
+            dmLogWarning("Max number of named threads (%u) reached, the remaining threads share one name", g_ThreadIdOther);
+        id = g_ThreadIdOther;
+    }
+    else
+    {
+        dmSnPrintf(g_ThreadNames[id], g_ThreadNameLength, "Thread%u", id);
+    }
+
+    SetThreadValue((value & g_ThreadSlotMask) | ((uintptr_t)(id + 1) << g_ThreadIdShift));
+    return id;
+}
+
+static uint32_t GetThreadIndex()
+{
+    uintptr_t value = GetThreadValue();
+    if (value & g_ThreadSlotMask)
+        return (uint32_t)(value & g_ThreadSlotMask) - 1;
+
+    uint32_t index = g_ThreadSlotCount.fetch_add(1, std::memory_order_relaxed);
+    if (index >= THREADS_OTHER)
+    {
+        if (index == THREADS_OTHER)
+            dmLogWarning("Max number of profiled threads (%u) reached, the remaining threads share one slot", THREADS_MAX);
+        index = THREADS_OTHER;
+    }
+    else
+    {
+        g_ThreadSlotIds[index] = GetThreadId();
+    }
+
+    value = GetThreadValue(); // GetThreadId() may have set the id
+    SetThreadValue((value & (g_ThreadIdMask << g_ThreadIdShift)) | (index + 1));
+    return index;
+}
+
+// The writer count keeps ThreadsFinalize from freeing the tls key under us
+uint32_t ThreadsGetId()
+{
+    uint32_t line = ShardedEnter(&g_ThreadWriters);
+    uint32_t id = g_ThreadsInitialized.load() ? GetThreadId() : g_ThreadIdOther;
+    ShardedLeave(&g_ThreadWriters, line);
+    return id;
+}
+
+uint32_t ThreadsGetIndex()
+{
+    uint32_t line = ShardedEnter(&g_ThreadWriters);
+    uint32_t index = g_ThreadsInitialized.load() ? GetThreadIndex() : THREADS_OTHER;
+    ShardedLeave(&g_ThreadWriters, line);
+    return index;
+}
+
+void ThreadsSetName(const char* name)
+{
+    uint32_t line = ShardedEnter(&g_ThreadWriters);
+    if (g_ThreadsInitialized.load())
+    {
+        uint32_t id = GetThreadId();
+        if (id != g_ThreadIdOther)
+            dmStrlCpy(g_ThreadNames[id], name, g_ThreadNameLength);
+    }
+    ShardedLeave(&g_ThreadWriters, line);
+}
+
+uint32_t ThreadsGetCount()
+{
+    uint32_t count = g_ThreadSlotCount.load(std::memory_order_acquire);
+    return count < THREADS_SLOT_COUNT ? count : THREADS_SLOT_COUNT;
+}
+
+const char* ThreadsGetName(uint32_t index)
+{
+    if (index == THREADS_OTHER)
+        return "Other";
+    return index < THREADS_OTHER ? g_ThreadNames[g_ThreadSlotIds[index]] : "";
+}
+
+const char* ThreadsGetNameById(uint32_t id)
+{
+    return id < THREADS_ID_MAX ? g_ThreadNames[id] : "";
+}
+
+void ThreadsInitialize()
+{
+    g_ThreadKey = dmThread::AllocTls();
+    g_ThreadIdCount.store(0, std::memory_order_relaxed);
+    g_ThreadSlotCount.store(0, std::memory_order_relaxed);
+    dmStrlCpy(g_ThreadNames[g_ThreadIdOther], "Other", g_ThreadNameLength);
+    g_ThreadGeneration = (g_ThreadGeneration + 1) & g_ThreadGenerationMask;
+    if (g_ThreadGeneration == 0)
+        g_ThreadGeneration = 1;
+    g_ThreadsInitialized.store(true);
+}
+
+void ThreadsFinalize()
+{
+    // New callers see the flag and leave. Wait for the ones that are still using the key
+    g_ThreadsInitialized.store(false);
+    ShardedDrain(&g_ThreadWriters);
+    dmThread::FreeTls(g_ThreadKey);
+}
@@ -0,0 +1,28 @@
+#ifndef DM_PROFILER_THREADS_H
+#define DM_PROFILER_THREADS_H
+
+#include <stdint.h>
+
+// The threads that were named with SetThreadName, or that logged a text or wrote to a property with per thread values.
+// A thread gets an id the first time it needs a name, and it only gets a value slot the first time it writes a property value.
+// When the slots run out, the remaining threads share the THREADS_OTHER slot. When the ids run out, they share the last one.
+
+static const uint32_t   THREADS_MAX = 32;                       // Threads with their own value slot
+static const uint32_t   THREADS_OTHER = THREADS_MAX;            // The slot of the threads after that
+static const uint32_t   THREADS_SLOT_COUNT = THREADS_MAX + 1;
+static const uint32_t   THREADS_ID_MAX = 256;
+
+void        ThreadsInitialize();
+void        ThreadsFinalize();
+
+// May be called from any thread. No locks, and no allocations
+uint32_t    ThreadsGetId();
+uint32_t    ThreadsGetIndex(); // The value slot
+void        ThreadsSetName(const char* name);
+
+// Number of value slots handed out so far
+uint32_t    ThreadsGetCount();
+const char* ThreadsGetName(uint32_t index);
+const char* ThreadsGetNameById(uint32_t id);
+
+#endif // DM_PROFILER_THREADS_H
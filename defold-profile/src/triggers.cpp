@@ -0,0 +1,264 @@
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/dstrings.h>
+#include <dmsdk/dlib/log.h>
+#include <dmsdk/dlib/mutex.h>
+
+#include <stdio.h>
+#include <stdlib.h> // free
+#include <string.h> // strdup
+
+#include "triggers.h"
+
+struct Trigger
+{
+    uint32_t        m_Id;
+    HProperty       m_Property;
+    TriggerOp       m_Op;
+    double          m_Threshold;
+    char*           m_DumpPrefix;
+    TriggerCallback m_Callback;
+    void*           m_Context;
+    bool            m_Active;   // The condition was true last frame
+    bool            m_Pending;  // Fired, waiting for TriggersUpdate()
+    double          m_FiredValue;
+    uint32_t        m_FiredFrame;
+};
+
+static dmMutex::HMutex      g_TriggerLock = 0;
+static dmArray<Trigger>     g_Triggers;
+static uint32_t             g_TriggerNextId = 1;
+
+// Only used from TriggersUpdate()
+static dmArray<TriggerEvent> g_TriggerEvents;
+static dmArray<HProperty>   g_DumpProperties;
+static dmArray<double>      g_DumpValues;   // One row per property
+static dmArray<uint32_t>    g_DumpCounts;   // Number of frames each property has, at the end of its row
+static char                 g_DumpPath[1024];
+
+static inline bool IsTriggered(TriggerOp op, double value, double threshold)
+{
+    switch (op)
+    {
+        case TRIGGER_OP_GT: return value > threshold;
+        case TRIGGER_OP_GE: return value >= threshold;
+        case TRIGGER_OP_LT: return value < threshold;
+        case TRIGGER_OP_LE: return value <= threshold;
+        default:            return false;
+    }
+}
+
+static Trigger* FindTrigger(uint32_t id)
+{
+    for (uint32_t i = 0; i < g_Triggers.Size(); ++i)
+    {
+        if (g_Triggers[i].m_Id == id)
+            return &g_Triggers[i];
+    }
+    return 0;
+}
+
+uint32_t TriggerCreate(HProperty property, TriggerOp op, double threshold, const char* dump_prefix, TriggerCallback callback, void* ctx)
+{
+    if (!g_TriggerLock || !PropertyIsValid(property) || PropertyGetType(property) == PROFILE_PROPERTY_TYPE_GROUP)
+        return 0;
+
+    Trigger trigger;
+    memset(&trigger, 0, sizeof(trigger));
+    trigger.m_Property      = property;
+    trigger.m_Op            = op;
+    trigger.m_Threshold     = threshold;
+    trigger.m_DumpPrefix    = dump_prefix ? strdup(dump_prefix) : 0;
+    trigger.m_Callback      = callback;
+    trigger.m_Context       = ctx;
+
+    DM_MUTEX_SCOPED_LOCK(g_TriggerLock);
+    trigger.m_Id = g_TriggerNextId++;
+    if (g_Triggers.Full())
+        g_Triggers.OffsetCapacity(16);
+    g_Triggers.Push(trigger);
+    return trigger.m_Id;
+}
+
+bool TriggerRemove(uint32_t id, void** ctx)
+{
+    if (!g_TriggerLock)
+        return false;
+
+    DM_MUTEX_SCOPED_LOCK(g_TriggerLock);
+    Trigger* trigger = FindTrigger(id);
+    if (!trigger)
+        return false;
+
+    if (ctx)
+        *ctx = trigger->m_Context;
+    free(trigger->m_DumpPrefix);
+    g_Triggers.EraseSwap(trigger - g_Triggers.Begin());
+    return true;
+}
+
+void TriggersFrameEnd()
+{
+    DM_MUTEX_SCOPED_LOCK(g_TriggerLock);
+    uint32_t frame = PropertyGetFrame();
+    for (uint32_t i = 0; i < g_Triggers.Size(); ++i)
+    {
+        Trigger* trigger = &g_Triggers[i];
+        double value = PropertyGetPrevNumber(trigger->m_Property);
+        bool active = IsTriggered(trigger->m_Op, value, trigger->m_Threshold);
+        if (active && !trigger->m_Active)
+        {
+            trigger->m_Pending      = true;
+            trigger->m_FiredValue   = value;
+            trigger->m_FiredFrame   = frame;
+        }
+        trigger->m_Active = active;
+    }
+}
+
+// Writes the history of all properties as a csv file, with one column per property and one row per frame.
+// Without the history, there's only the last frame
+static bool WriteDump(const char* path, uint32_t fired_frame)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        dmLogError("Failed to open '%s'", path);
+        return false;
+    }
+
+    g_DumpProperties.SetSize(0);
+    const PropertyTreeNode* nodes;
+    uint32_t num_nodes = PropertyGetTree(&nodes);
+    for (uint32_t i = 0; i < num_nodes; ++i)
+    {
+        if (PropertyGetType(nodes[i].m_Property) == PROFILE_PROPERTY_TYPE_GROUP)
+            continue;
+        if (g_DumpProperties.Full())
+            g_DumpProperties.OffsetCapacity(256);
+        g_DumpProperties.Push(nodes[i].m_Property);
+    }
+
+    uint32_t num_properties = g_DumpProperties.Size();
+    uint32_t num_frames = PropertyGetHistorySize();
+    if (num_frames == 0)
+        num_frames = 1;
+    if (g_DumpValues.Capacity() < num_properties * num_frames)
+        g_DumpValues.SetCapacity(num_properties * num_frames);
+    g_DumpValues.SetSize(num_properties * num_frames);
+    if (g_DumpCounts.Capacity() < num_properties)
+        g_DumpCounts.SetCapacity(num_properties);
+    g_DumpCounts.SetSize(num_properties);
+
+    fprintf(file, "frame");
+    char path_buffer[256];
+    for (uint32_t i = 0; i < num_properties; ++i)
+    {
+        HProperty property = g_DumpProperties[i];
+        PropertyGetPath(property, path_buffer, sizeof(path_buffer));
+        fprintf(file, ",%s", path_buffer);
+
+        // A property registered during the history has fewer frames, and the cells before it are left empty
+        double* values = &g_DumpValues[i * num_frames];
+        uint32_t count = PropertyGetHistory(property, values, num_frames);
+        if (count == 0)
+        {
+            values[0] = PropertyGetPrevNumber(property);
+            count = 1;
+        }
+        memmove(&values[num_frames - count], values, count * sizeof(double));
+        g_DumpCounts[i] = count;
+    }
+    fprintf(file, "\n");
+
+    for (uint32_t frame = 0; frame < num_frames; ++frame)
+    {
+        fprintf(file, "%u", fired_frame - (num_frames - 1 - frame));
+        for (uint32_t i = 0; i < num_properties; ++i)
+        {
+            if (frame + g_DumpCounts[i] < num_frames)
+                fprintf(file, ",");
+            else
+                fprintf(file, ",%.15g", g_DumpValues[i * num_frames + frame]);
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    return true;
+}
+
+void TriggersUpdate()
+{
+    if (!g_TriggerLock)
+        return;
+
+    // The callbacks may create or remove triggers, so they're called without holding the lock
+    g_TriggerEvents.SetSize(0);
+    {
+        DM_MUTEX_SCOPED_LOCK(g_TriggerLock);
+        for (uint32_t i = 0; i < g_Triggers.Size(); ++i)
+        {
+            Trigger* trigger = &g_Triggers[i];
+            if (!trigger->m_Pending)
+                continue;
+            trigger->m_Pending = false;
+
+            TriggerEvent event;
+            event.m_Id          = trigger->m_Id;
+            event.m_Property    = trigger->m_Property;
+            event.m_Value       = trigger->m_FiredValue;
+            event.m_Threshold   = trigger->m_Threshold;
+            event.m_Frame       = trigger->m_FiredFrame;
+            event.m_DumpPath    = 0;
+            if (g_TriggerEvents.Full())
+                g_TriggerEvents.OffsetCapacity(16);
+            g_TriggerEvents.Push(event);
+        }
+    }
+
+    // Several rules firing in the same frame, with the same prefix, share the dump
+    g_DumpPath[0] = 0;
+    for (uint32_t i = 0; i < g_TriggerEvents.Size(); ++i)
+    {
+        TriggerEvent* event = &g_TriggerEvents[i];
+
+        TriggerCallback callback = 0;
+        void* ctx = 0;
+        {
+            DM_MUTEX_SCOPED_LOCK(g_TriggerLock);
+            Trigger* trigger = FindTrigger(event->m_Id);
+            if (!trigger)
+                continue; // Removed by an earlier callback
+
+            if (trigger->m_DumpPrefix)
+            {
+                char path[sizeof(g_DumpPath)];
+                dmSnPrintf(path, sizeof(path), "%s_%u.csv", trigger->m_DumpPrefix, event->m_Frame);
+                if (strcmp(path, g_DumpPath) == 0 || WriteDump(path, event->m_Frame))
+                {
+                    dmStrlCpy(g_DumpPath, path, sizeof(g_DumpPath));
+                    event->m_DumpPath = g_DumpPath;
+                }
+            }
+            callback = trigger->m_Callback;
+            ctx = trigger->m_Context;
+        }
+
+        if (callback)
+            callback(event, ctx);
+    }
+}
+
+void TriggersInitialize()
+{
+    g_TriggerLock = dmMutex::New();
+}
+
+void TriggersFinalize()
+{
+    dmMutex::Delete(g_TriggerLock);
+    g_TriggerLock = 0;
+    for (uint32_t i = 0; i < g_Triggers.Size(); ++i)
+        free(g_Triggers[i].m_DumpPrefix);
+    g_Triggers.SetSize(0);
+}
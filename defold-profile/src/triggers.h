@@ -0,0 +1,44 @@
+#ifndef DM_PROFILER_TRIGGERS_H
+#define DM_PROFILER_TRIGGERS_H
+
+#include "profiler.h"
+
+// Threshold rules, checked against the published values at the end of each frame.
+// A rule fires when its condition becomes true (not while it stays true). The history of all properties
+// (profiler_counter.history_frames) is then dumped, and the callback is called, from TriggersUpdate().
+
+enum TriggerOp
+{
+    TRIGGER_OP_GT,
+    TRIGGER_OP_GE,
+    TRIGGER_OP_LT,
+    TRIGGER_OP_LE,
+};
+
+struct TriggerEvent
+{
+    uint32_t    m_Id;
+    HProperty   m_Property;
+    double      m_Value;        // The value that fired the rule
+    double      m_Threshold;
+    uint32_t    m_Frame;        // PropertyGetFrame() of the frame that fired the rule
+    const char* m_DumpPath;     // The file the history was written to, or 0
+};
+
+typedef void (*TriggerCallback)(const TriggerEvent* event, void* ctx);
+
+// The history is written to "<dump_prefix>_<frame>.csv" if dump_prefix isn't 0, and the callback is called if it isn't 0.
+// Returns the id of the rule, or 0 if the property isn't valid
+uint32_t    TriggerCreate(HProperty property, TriggerOp op, double threshold, const char* dump_prefix, TriggerCallback callback, void* ctx);
+// Returns the callback context, so the caller can free it
+bool        TriggerRemove(uint32_t id, void** ctx);
+
+void        TriggersInitialize();
+void        TriggersFinalize();
+
+// Called from FrameEnd, after the frame has been published and recorded in the history. Doesn't allocate
+void        TriggersFrameEnd();
+// Called from the extension update, outside of the frame end, to write the dumps and call the callbacks
+void        TriggersUpdate();
+
+#endif // DM_PROFILER_TRIGGERS_H
@@ -0,0 +1,389 @@
+// Standalone benchmark of the counter listener, built against the stubbed dmsdk in stub/.
+// The extension is linked into this process, so the numbers never include (or disturb) a running game.
+// Prints the results as json, and also writes them to the file if a path is given.
+//
+// Build: make -C tools/bench
+// Usage: tools/bench/profile_bench [<json file>]
+
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/profile.h>
+#include <dmsdk/dlib/thread.h>
+#include <dmsdk/dlib/time.h>
+
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h> // qsort
+
+#include "../../defold-profile/src/profiler.h"
+#include "sdk_stub.h"
+
+#if defined(BENCH_LUA)
+#include <dmsdk/script/script.h>
+#else
+// Without a Lua VM, script.cpp isn't built, and the get_properties section is skipped
+void ScriptInit(lua_State* L) {}
+void ScriptFinalize(lua_State* L) {}
+#endif
+
+static const uint32_t   g_BenchmarkMaxThreads   = 8;
+static const uint32_t   g_BenchmarkWriteCount   = 1000000; // Per thread
+static const uint32_t   g_BenchmarkFrameCount   = 200;
+static const uint32_t   g_BenchmarkScriptCount  = 50;
+static const uint32_t   g_BenchmarkSizes[]      = { 64, 256, 1024, 4096 };
+static const uint32_t   g_BenchmarkSizeCount    = sizeof(g_BenchmarkSizes) / sizeof(g_BenchmarkSizes[0]);
+
+// The properties are all registered up front, in one group per size, so each size is its own subtree
+static ProfileIdx       g_WriteProperties;                      // The first of g_BenchmarkMaxThreads properties
+static ProfileIdx       g_SizeGroups[g_BenchmarkSizeCount];
+static ProfileIdx       g_SizeProperties[g_BenchmarkSizeCount]; // The first property of each size
+static char             g_Names[65536];
+static uint32_t         g_NamesSize = 0;
+
+struct BenchmarkWriter
+{
+    ProfileListener*        m_Listener;
+    ProfileIdx              m_Property;
+    bool                    m_Set;
+    uint64_t                m_End;
+};
+
+struct BenchmarkTimings
+{
+    double  m_Mean;
+    double  m_Min;
+    double  m_Max;
+    double  m_P99;
+};
+
+struct BenchmarkOutput
+{
+    dmArray<char>   m_Buffer;
+    bool            m_First;
+};
+
+static std::atomic<uint32_t>    g_WritersReady(0);
+static std::atomic<bool>        g_WritersGo(false);
+
+static void Append(BenchmarkOutput* out, const char* format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length <= 0)
+        return;
+    if ((uint32_t)length >= sizeof(buffer))
+        length = sizeof(buffer) - 1;
+
+    if (out->m_Buffer.Remaining() < (uint32_t)length)
+        out->m_Buffer.OffsetCapacity(length + 4096);
+    out->m_Buffer.PushArray(buffer, length);
+}
+
+// Appends a ',' before all but the first entry of an array
+static void AppendSeparator(BenchmarkOutput* out)
+{
+    if (!out->m_First)
+        Append(out, ",");
+    out->m_First = false;
+}
+
+static int CompareDouble(const void* a, const void* b)
+{
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+static BenchmarkTimings GetTimings(double* samples, uint32_t count)
+{
+    qsort(samples, count, sizeof(double), CompareDouble);
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; ++i)
+        sum += samples[i];
+
+    BenchmarkTimings timings;
+    timings.m_Mean  = sum / count;
+    timings.m_Min   = samples[0];
+    timings.m_Max   = samples[count - 1];
+    timings.m_P99   = samples[(count * 99) / 100 < count ? (count * 99) / 100 : count - 1];
+    return timings;
+}
+
+static void AppendTimings(BenchmarkOutput* out, const BenchmarkTimings& timings)
+{
+    Append(out, "\"mean_us\":%.3f,\"min_us\":%.3f,\"max_us\":%.3f,\"p99_us\":%.3f",
+                timings.m_Mean, timings.m_Min, timings.m_Max, timings.m_P99);
+}
+
+// The listener keeps the name pointers
+static const char* MakeName(const char* format, uint32_t i)
+{
+    char* name = &g_Names[g_NamesSize];
+    int length = snprintf(name, sizeof(g_Names) - g_NamesSize, format, i);
+    g_NamesSize += length + 1;
+    return name;
+}
+
+static void RegisterProperties(ProfileListener* listener)
+{
+    ProfileIdx idx = 1;
+    ProfileIdx group = idx++;
+    listener->m_CreatePropertyGroup(0, "Benchmark", "", group, 0);
+
+    ProfileIdx writes = idx++;
+    listener->m_CreatePropertyGroup(0, "Writes", "", writes, group);
+    g_WriteProperties = idx;
+    for (uint32_t i = 0; i < g_BenchmarkMaxThreads; ++i)
+        listener->m_CreatePropertyU32(0, MakeName("Write%u", i), "", 0, PROFILE_PROPERTY_FRAME_RESET, idx++, writes);
+
+    for (uint32_t s = 0; s < g_BenchmarkSizeCount; ++s)
+    {
+        g_SizeGroups[s] = idx++;
+        listener->m_CreatePropertyGroup(0, MakeName("Size%u", g_BenchmarkSizes[s]), "", g_SizeGroups[s], group);
+        g_SizeProperties[s] = idx;
+        for (uint32_t i = 0; i < g_BenchmarkSizes[s]; ++i)
+            listener->m_CreatePropertyU32(0, MakeName("P%u", i), "", 0, PROFILE_PROPERTY_FRAME_RESET, idx++, g_SizeGroups[s]);
+    }
+}
+
+// Writes all the properties of a size, so they are all published in the next frame
+static void WriteSize(ProfileListener* listener, uint32_t s)
+{
+    for (uint32_t i = 0; i < g_BenchmarkSizes[s]; ++i)
+        listener->m_PropertyAddU32(0, g_SizeProperties[s] + i, 1);
+}
+
+// ****************************************************************************
+// Set/Add throughput
+
+static void WriterThread(void* ctx)
+{
+    BenchmarkWriter* writer = (BenchmarkWriter*)ctx;
+    ProfileListener* listener = writer->m_Listener;
+    ProfileIdx property = writer->m_Property;
+
+    // Only the steady state is timed, not the thread start up
+    g_WritersReady.fetch_add(1);
+    while (!g_WritersGo.load(std::memory_order_acquire))
+        ;
+
+    if (writer->m_Set)
+    {
+        for (uint32_t i = 0; i < g_BenchmarkWriteCount; ++i)
+            listener->m_PropertySetU32(0, property, i);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < g_BenchmarkWriteCount; ++i)
+            listener->m_PropertyAddU32(0, property, 1);
+    }
+    writer->m_End = dmTime::GetTime();
+}
+
+// Returns the number of writes per second, over all threads
+static double RunWriters(ProfileListener* listener, uint32_t thread_count, bool set, bool shared)
+{
+    BenchmarkWriter writers[g_BenchmarkMaxThreads];
+    dmThread::Thread threads[g_BenchmarkMaxThreads];
+
+    g_WritersReady.store(0);
+    g_WritersGo.store(false);
+    for (uint32_t i = 0; i < thread_count; ++i)
+    {
+        writers[i].m_Listener = listener;
+        writers[i].m_Property = g_WriteProperties + (shared ? 0 : i);
+        writers[i].m_Set = set;
+        writers[i].m_End = 0;
+        threads[i] = dmThread::New(WriterThread, 0x10000, &writers[i], "profile_bench");
+    }
+    while (g_WritersReady.load() != thread_count)
+        ;
+
+    uint64_t start = dmTime::GetTime();
+    g_WritersGo.store(true, std::memory_order_release);
+    for (uint32_t i = 0; i < thread_count; ++i)
+        dmThread::Join(threads[i]);
+
+    uint64_t end = start;
+    for (uint32_t i = 0; i < thread_count; ++i)
+        end = writers[i].m_End > end ? writers[i].m_End : end;
+
+    listener->m_FrameEnd(0);
+    uint64_t elapsed = end - start;
+    return (double)thread_count * g_BenchmarkWriteCount * 1000000.0 / (double)(elapsed ? elapsed : 1);
+}
+
+static void BenchmarkWrites(BenchmarkOutput* out, ProfileListener* listener)
+{
+    Append(out, "\"writes\":[");
+    out->m_First = true;
+    for (uint32_t threads = 1; threads <= g_BenchmarkMaxThreads; threads *= 2)
+    {
+        for (uint32_t shared = 0; shared < 2; ++shared)
+        {
+            for (uint32_t set = 0; set < 2; ++set)
+            {
+                double ops = RunWriters(listener, threads, set != 0, shared != 0);
+                AppendSeparator(out);
+                Append(out, "{\"op\":\"%s\",\"threads\":%u,\"shared\":%s,\"ops_per_sec\":%.0f}",
+                            set ? "set" : "add", threads, shared ? "true" : "false", ops);
+            }
+        }
+    }
+    Append(out, "]");
+}
+
+// ****************************************************************************
+// FrameEnd latency
+
+static void BenchmarkFrameEnd(BenchmarkOutput* out, ProfileListener* listener)
+{
+    double samples[g_BenchmarkFrameCount];
+
+    Append(out, "\"frame_end\":[");
+    out->m_First = true;
+    for (uint32_t s = 0; s < g_BenchmarkSizeCount; ++s)
+    {
+        for (uint32_t frame = 0; frame < g_BenchmarkFrameCount; ++frame)
+        {
+            WriteSize(listener, s);
+            uint64_t start = dmTime::GetTime();
+            listener->m_FrameEnd(0);
+            samples[frame] = (double)(dmTime::GetTime() - start);
+        }
+
+        AppendSeparator(out);
+        Append(out, "{\"properties\":%u,\"total_properties\":%u,", g_BenchmarkSizes[s], PropertyGetCount());
+        AppendTimings(out, GetTimings(samples, g_BenchmarkFrameCount));
+        Append(out, "}");
+    }
+    Append(out, "]");
+}
+
+// ****************************************************************************
+// get_properties time and allocations
+
+#if defined(BENCH_LUA)
+
+static int GetMemoryCount(lua_State* L)
+{
+    return lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+// Calls profile.get_properties(options) and returns the time in microseconds, and the number of bytes allocated
+static double CallGetProperties(lua_State* L, bool reuse, uint32_t* allocated)
+{
+    lua_getglobal(L, "profile");
+    lua_getfield(L, -1, "get_properties");
+    lua_createtable(L, 0, 1);
+    lua_pushboolean(L, reuse);
+    lua_setfield(L, -2, "reuse");
+
+    int before = GetMemoryCount(L);
+    uint64_t start = dmTime::GetTime();
+    lua_call(L, 1, 1);
+    uint64_t elapsed = dmTime::GetTime() - start;
+    int after = GetMemoryCount(L);
+
+    lua_pop(L, 2);
+    *allocated = after > before ? (uint32_t)(after - before) : 0;
+    return (double)elapsed;
+}
+
+static void BenchmarkScript(BenchmarkOutput* out, lua_State* L, ProfileListener* listener)
+{
+    double samples[g_BenchmarkScriptCount];
+
+    // Stop the collector, so the allocations can be measured from the memory count
+    lua_gc(L, LUA_GCSTOP, 0);
+
+    Append(out, "\"get_properties\":[");
+    out->m_First = true;
+    for (uint32_t s = 0; s < g_BenchmarkSizeCount; ++s)
+    {
+        // Only the properties of this size are used in the frame, so the others are skipped in one check
+        WriteSize(listener, s);
+        listener->m_FrameEnd(0);
+
+        for (uint32_t reuse = 0; reuse < 2; ++reuse)
+        {
+            uint32_t allocated = 0;
+            CallGetProperties(L, reuse != 0, &allocated); // Warm up, builds the cached tree when reusing
+            for (uint32_t i = 0; i < g_BenchmarkScriptCount; ++i)
+            {
+                samples[i] = CallGetProperties(L, reuse != 0, &allocated);
+                lua_gc(L, LUA_GCCOLLECT, 0);
+                lua_gc(L, LUA_GCSTOP, 0);
+            }
+
+            AppendSeparator(out);
+            Append(out, "{\"properties\":%u,\"reuse\":%s,\"allocated_bytes\":%u,",
+                        g_BenchmarkSizes[s], reuse ? "true" : "false", allocated);
+            AppendTimings(out, GetTimings(samples, g_BenchmarkScriptCount));
+            Append(out, "}");
+        }
+    }
+    Append(out, "]");
+
+    lua_gc(L, LUA_GCRESTART, 0);
+}
+
+#endif
+
+// ****************************************************************************
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : 0;
+
+    dmExtension::Desc* extension = StubGetExtension();
+    dmExtension::AppParams app_params = {};
+    extension->m_AppInitialize(&app_params);
+
+    ProfileListener* listener = StubGetProfiler();
+    void* ctx = listener->m_Create();
+    RegisterProperties(listener);
+
+    dmExtension::Params params = {};
+#if defined(BENCH_LUA)
+    params.m_L = luaL_newstate();
+    luaL_openlibs(params.m_L);
+#endif
+    extension->m_Initialize(&params);
+
+    BenchmarkOutput out;
+    out.m_First = true;
+    Append(&out, "{");
+    BenchmarkWrites(&out, listener);
+    Append(&out, ",");
+    BenchmarkFrameEnd(&out, listener);
+#if defined(BENCH_LUA)
+    Append(&out, ",");
+    BenchmarkScript(&out, params.m_L, listener);
+#endif
+    Append(&out, "}\n");
+
+    extension->m_Finalize(&params);
+#if defined(BENCH_LUA)
+    lua_close(params.m_L);
+#endif
+    listener->m_Destroy(ctx);
+    extension->m_AppFinalize(&app_params);
+
+    fwrite(out.m_Buffer.Begin(), 1, out.m_Buffer.Size(), stdout);
+    if (path)
+    {
+        FILE* file = fopen(path, "wb");
+        if (!file)
+        {
+            fprintf(stderr, "Failed to open '%s'\n", path);
+            return 1;
+        }
+        fwrite(out.m_Buffer.Begin(), 1, out.m_Buffer.Size(), file);
+        fclose(file);
+    }
+    return 0;
+}
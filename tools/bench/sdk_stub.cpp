@@ -0,0 +1,304 @@
+// Implementation of the stubbed dmsdk functions, on top of pthreads and libc
+
+#include <dmsdk/dlib/condition_variable.h>
+#include <dmsdk/dlib/configfile.h>
+#include <dmsdk/dlib/dstrings.h>
+#include <dmsdk/dlib/hash.h>
+#include <dmsdk/dlib/mutex.h>
+#include <dmsdk/dlib/thread.h>
+#include <dmsdk/dlib/time.h>
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sdk_stub.h"
+
+#if defined(BENCH_LUA)
+#include <dmsdk/script/script.h>
+#endif
+
+static ProfileListener*     g_StubProfiler = 0;
+static dmExtension::Desc*   g_StubExtension = 0;
+
+void ProfileRegisterProfiler(const char* name, ProfileListener* profiler)
+{
+    (void)name;
+    g_StubProfiler = profiler;
+}
+
+ProfileListener* StubGetProfiler()
+{
+    return g_StubProfiler;
+}
+
+namespace dmExtension
+{
+    void Register(Desc* desc)
+    {
+        g_StubExtension = desc;
+    }
+}
+
+dmExtension::Desc* StubGetExtension()
+{
+    return g_StubExtension;
+}
+
+// ****************************************************************************
+
+namespace dmMutex
+{
+    HMutex New()
+    {
+        HMutex mutex = (HMutex)malloc(sizeof(pthread_mutex_t));
+        pthread_mutex_init(mutex, 0);
+        return mutex;
+    }
+
+    void Delete(HMutex mutex)
+    {
+        pthread_mutex_destroy(mutex);
+        free(mutex);
+    }
+
+    void Lock(HMutex mutex)     { pthread_mutex_lock(mutex); }
+    bool TryLock(HMutex mutex)  { return pthread_mutex_trylock(mutex) == 0; }
+    void Unlock(HMutex mutex)   { pthread_mutex_unlock(mutex); }
+}
+
+namespace dmConditionVariable
+{
+    HConditionVariable New()
+    {
+        HConditionVariable condition = (HConditionVariable)malloc(sizeof(pthread_cond_t));
+        pthread_cond_init(condition, 0);
+        return condition;
+    }
+
+    void Delete(HConditionVariable condition)
+    {
+        pthread_cond_destroy(condition);
+        free(condition);
+    }
+
+    void Wait(HConditionVariable condition, dmMutex::HMutex mutex)  { pthread_cond_wait(condition, mutex); }
+    void Signal(HConditionVariable condition)                       { pthread_cond_signal(condition); }
+    void Broadcast(HConditionVariable condition)                    { pthread_cond_broadcast(condition); }
+}
+
+namespace dmThread
+{
+    struct StartInfo
+    {
+        ThreadStart m_Start;
+        void*       m_Arg;
+    };
+
+    static void* ThreadMain(void* arg)
+    {
+        StartInfo info = *(StartInfo*)arg;
+        free(arg);
+        info.m_Start(info.m_Arg);
+        return 0;
+    }
+
+    Thread New(ThreadStart thread_start, uint32_t stack_size, void* arg, const char* name)
+    {
+        (void)stack_size;
+        (void)name;
+        StartInfo* info = (StartInfo*)malloc(sizeof(StartInfo));
+        info->m_Start = thread_start;
+        info->m_Arg = arg;
+        pthread_t thread;
+        pthread_create(&thread, 0, ThreadMain, info);
+        return thread;
+    }
+
+    void    Join(Thread thread)                     { pthread_join(thread, 0); }
+    Thread  GetCurrentThread()                      { return pthread_self(); }
+
+    TlsKey AllocTls()
+    {
+        pthread_key_t key;
+        pthread_key_create(&key, 0);
+        return key;
+    }
+
+    void    FreeTls(TlsKey key)                     { pthread_key_delete(key); }
+    void    SetTlsValue(TlsKey key, void* value)    { pthread_setspecific(key, value); }
+    void*   GetTlsValue(TlsKey key)                 { return pthread_getspecific(key); }
+}
+
+namespace dmTime
+{
+    uint64_t GetTime()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+    }
+
+    void Sleep(uint32_t useconds)
+    {
+        usleep(useconds);
+    }
+}
+
+// ****************************************************************************
+
+namespace dmConfigFile
+{
+    // "profiler_counter.history_frames" -> PROFILER_COUNTER_HISTORY_FRAMES
+    static const char* GetEnv(const char* key)
+    {
+        char name[256];
+        uint32_t i = 0;
+        for (; key[i] && i < sizeof(name) - 1; ++i)
+            name[i] = key[i] == '.' ? '_' : (char)toupper((unsigned char)key[i]);
+        name[i] = 0;
+        return getenv(name);
+    }
+
+    int32_t GetInt(HConfig config, const char* key, int32_t default_value)
+    {
+        const char* value = GetEnv(key);
+        return value ? atoi(value) : default_value;
+    }
+
+    float GetFloat(HConfig config, const char* key, float default_value)
+    {
+        const char* value = GetEnv(key);
+        return value ? (float)atof(value) : default_value;
+    }
+
+    const char* GetString(HConfig config, const char* key, const char* default_value)
+    {
+        const char* value = GetEnv(key);
+        return value ? value : default_value;
+    }
+}
+
+size_t dmStrlCpy(char* dst, const char* src, size_t size)
+{
+    size_t length = strlen(src);
+    if (size)
+    {
+        size_t count = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, count);
+        dst[count] = 0;
+    }
+    return length;
+}
+
+size_t dmStrlCat(char* dst, const char* src, size_t size)
+{
+    size_t length = strnlen(dst, size);
+    if (length == size)
+        return size + strlen(src);
+    return length + dmStrlCpy(dst + length, src, size - length);
+}
+
+int dmSnPrintf(char* buffer, size_t count, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int result = vsnprintf(buffer, count, format, args);
+    va_end(args);
+    return result;
+}
+
+char* dmStrTok(char* string, const char* delimiters, char** lasts)
+{
+    return strtok_r(string, delimiters, lasts);
+}
+
+int dmStrCaseCmp(const char* s1, const char* s2)
+{
+    return strcasecmp(s1, s2);
+}
+
+// FNV-1a
+uint32_t dmHashBuffer32(const void* buffer, uint32_t buffer_len)
+{
+    const uint8_t* bytes = (const uint8_t*)buffer;
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < buffer_len; ++i)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+uint32_t dmHashString32(const char* string)
+{
+    return dmHashBuffer32(string, (uint32_t)strlen(string));
+}
+
+dmhash_t dmHashBuffer64(const void* buffer, uint32_t buffer_len)
+{
+    const uint8_t* bytes = (const uint8_t*)buffer;
+    uint64_t hash = 14695981039346656037ull;
+    for (uint32_t i = 0; i < buffer_len; ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+dmhash_t dmHashString64(const char* string)
+{
+    return dmHashBuffer64(string, (uint32_t)strlen(string));
+}
+
+// ****************************************************************************
+
+#if defined(BENCH_LUA)
+namespace dmScript
+{
+    struct LuaCallbackInfo
+    {
+        lua_State*  m_L;
+        int         m_Callback;
+    };
+
+    LuaCallbackInfo* CreateCallback(lua_State* L, int callback_stack_index)
+    {
+        LuaCallbackInfo* cbk = (LuaCallbackInfo*)malloc(sizeof(LuaCallbackInfo));
+        lua_pushvalue(L, callback_stack_index);
+        cbk->m_L = L;
+        cbk->m_Callback = luaL_ref(L, LUA_REGISTRYINDEX);
+        return cbk;
+    }
+
+    bool IsCallbackValid(LuaCallbackInfo* cbk)
+    {
+        return cbk && cbk->m_Callback != LUA_NOREF;
+    }
+
+    void DestroyCallback(LuaCallbackInfo* cbk)
+    {
+        luaL_unref(cbk->m_L, LUA_REGISTRYINDEX, cbk->m_Callback);
+        free(cbk);
+    }
+
+    // Called as callback(self, ...), with nil as self and the arguments pushed by fn
+    bool InvokeCallback(LuaCallbackInfo* cbk, void (*fn)(lua_State* L, void* ctx), void* ctx)
+    {
+        lua_State* L = cbk->m_L;
+        int top = lua_gettop(L);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, cbk->m_Callback);
+        lua_pushnil(L);
+        if (fn)
+            fn(L, ctx);
+        bool ok = lua_pcall(L, lua_gettop(L) - top - 1, 0, 0) == 0;
+        if (!ok)
+        {
+            fprintf(stderr, "ERROR: %s\n", lua_tostring(L, -1));
+            lua_settop(L, top);
+        }
+        return ok;
+    }
+}
+#endif
@@ -0,0 +1,11 @@
+#ifndef DM_PROFILER_BENCH_SDK_STUB_H
+#define DM_PROFILER_BENCH_SDK_STUB_H
+
+#include <dmsdk/dlib/profile.h>
+#include <dmsdk/extension/extension.h>
+
+// What the extension registered when it was loaded, since there's no engine to call it
+ProfileListener*    StubGetProfiler();
+dmExtension::Desc*  StubGetExtension();
+
+#endif // DM_PROFILER_BENCH_SDK_STUB_H
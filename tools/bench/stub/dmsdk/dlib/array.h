@@ -0,0 +1,65 @@
+#ifndef DMSDK_ARRAY_H
+#define DMSDK_ARRAY_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Same interface as the dmArray of the engine, for the POD types the extension stores in it
+template <typename T>
+class dmArray
+{
+public:
+    dmArray() : m_Buffer(0), m_Size(0), m_Capacity(0) {}
+    ~dmArray() { free(m_Buffer); }
+
+    T*          Begin()                         { return m_Buffer; }
+    const T*    Begin() const                   { return m_Buffer; }
+    T*          End()                           { return m_Buffer + m_Size; }
+    const T*    End() const                     { return m_Buffer + m_Size; }
+    T&          Front()                         { assert(m_Size); return m_Buffer[0]; }
+    T&          Back()                          { assert(m_Size); return m_Buffer[m_Size - 1]; }
+    T&          operator[](uint32_t i)          { assert(i < m_Size); return m_Buffer[i]; }
+    const T&    operator[](uint32_t i) const    { assert(i < m_Size); return m_Buffer[i]; }
+
+    uint32_t    Size() const                    { return m_Size; }
+    uint32_t    Capacity() const                { return m_Capacity; }
+    uint32_t    Remaining() const               { return m_Capacity - m_Size; }
+    bool        Full() const                    { return m_Size == m_Capacity; }
+    bool        Empty() const                   { return m_Size == 0; }
+
+    void SetCapacity(uint32_t capacity)
+    {
+        assert(capacity >= m_Size);
+        m_Buffer = (T*)realloc(m_Buffer, sizeof(T) * capacity);
+        m_Capacity = capacity;
+    }
+    void OffsetCapacity(int32_t offset)         { SetCapacity(m_Capacity + offset); }
+    void SetSize(uint32_t size)                 { assert(size <= m_Capacity); m_Size = size; }
+
+    void Push(const T& value)                   { assert(m_Size < m_Capacity); m_Buffer[m_Size++] = value; }
+    void PushArray(const T* values, uint32_t count)
+    {
+        assert(m_Size + count <= m_Capacity);
+        memcpy(m_Buffer + m_Size, values, sizeof(T) * count);
+        m_Size += count;
+    }
+    void Pop()                                  { assert(m_Size); --m_Size; }
+    T& EraseSwap(uint32_t i)
+    {
+        assert(i < m_Size);
+        m_Buffer[i] = m_Buffer[--m_Size];
+        return m_Buffer[i];
+    }
+
+private:
+    T*          m_Buffer;
+    uint32_t    m_Size;
+    uint32_t    m_Capacity;
+
+    dmArray(const dmArray&);
+    void operator=(const dmArray&);
+};
+
+#endif // DMSDK_ARRAY_H
@@ -0,0 +1,17 @@
+#ifndef DMSDK_ATOMIC_H
+#define DMSDK_ATOMIC_H
+
+#include <stdint.h>
+
+typedef volatile int32_t int32_atomic_t;
+
+// All of them return the previous value, like the engine versions
+inline int32_t dmAtomicIncrement32(int32_atomic_t* ptr)                             { return __sync_fetch_and_add(ptr, 1); }
+inline int32_t dmAtomicDecrement32(int32_atomic_t* ptr)                             { return __sync_fetch_and_sub(ptr, 1); }
+inline int32_t dmAtomicAdd32(int32_atomic_t* ptr, int32_t value)                    { return __sync_fetch_and_add(ptr, value); }
+inline int32_t dmAtomicSub32(int32_atomic_t* ptr, int32_t value)                    { return __sync_fetch_and_sub(ptr, value); }
+inline int32_t dmAtomicStore32(int32_atomic_t* ptr, int32_t value)                  { return __sync_lock_test_and_set(ptr, value); }
+inline int32_t dmAtomicCompareStore32(int32_atomic_t* ptr, int32_t value, int32_t comparand) { return __sync_val_compare_and_swap(ptr, comparand, value); }
+inline int32_t dmAtomicGet32(int32_atomic_t* ptr)                                   { return __sync_fetch_and_add(ptr, 0); }
+
+#endif // DMSDK_ATOMIC_H
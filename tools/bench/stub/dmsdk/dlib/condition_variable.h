@@ -0,0 +1,17 @@
+#ifndef DMSDK_CONDITION_VARIABLE_H
+#define DMSDK_CONDITION_VARIABLE_H
+
+#include <dmsdk/dlib/mutex.h>
+
+namespace dmConditionVariable
+{
+    typedef pthread_cond_t* HConditionVariable;
+
+    HConditionVariable  New();
+    void                Delete(HConditionVariable condition);
+    void                Wait(HConditionVariable condition, dmMutex::HMutex mutex);
+    void                Signal(HConditionVariable condition);
+    void                Broadcast(HConditionVariable condition);
+}
+
+#endif // DMSDK_CONDITION_VARIABLE_H
@@ -0,0 +1,17 @@
+#ifndef DMSDK_CONFIGFILE_H
+#define DMSDK_CONFIGFILE_H
+
+#include <stdint.h>
+
+// The values are read from the environment instead of game.project,
+// e.g. profiler_counter.history_frames is PROFILER_COUNTER_HISTORY_FRAMES
+namespace dmConfigFile
+{
+    typedef struct Config* HConfig;
+
+    int32_t     GetInt(HConfig config, const char* key, int32_t default_value);
+    float       GetFloat(HConfig config, const char* key, float default_value);
+    const char* GetString(HConfig config, const char* key, const char* default_value);
+}
+
+#endif // DMSDK_CONFIGFILE_H
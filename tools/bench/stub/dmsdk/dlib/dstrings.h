@@ -0,0 +1,12 @@
+#ifndef DMSDK_DSTRINGS_H
+#define DMSDK_DSTRINGS_H
+
+#include <stddef.h>
+
+size_t  dmStrlCpy(char* dst, const char* src, size_t size);
+size_t  dmStrlCat(char* dst, const char* src, size_t size);
+int     dmSnPrintf(char* buffer, size_t count, const char* format, ...);
+char*   dmStrTok(char* string, const char* delimiters, char** lasts);
+int     dmStrCaseCmp(const char* s1, const char* s2);
+
+#endif // DMSDK_DSTRINGS_H
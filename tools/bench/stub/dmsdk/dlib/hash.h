@@ -0,0 +1,14 @@
+#ifndef DMSDK_HASH_H
+#define DMSDK_HASH_H
+
+#include <stdint.h>
+
+typedef uint64_t dmhash_t;
+
+// Not the hash function of the engine, only the same interface
+uint32_t    dmHashBuffer32(const void* buffer, uint32_t buffer_len);
+uint32_t    dmHashString32(const char* string);
+dmhash_t    dmHashBuffer64(const void* buffer, uint32_t buffer_len);
+dmhash_t    dmHashString64(const char* string);
+
+#endif // DMSDK_HASH_H
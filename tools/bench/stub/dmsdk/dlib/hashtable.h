@@ -0,0 +1,54 @@
+#ifndef DMSDK_HASHTABLE_H
+#define DMSDK_HASHTABLE_H
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <map>
+
+// Same interface as the dmHashTable of the engine, backed by a std::map.
+// Like the engine version, Put() asserts that there is room for a new key.
+template <typename KEY, typename T>
+class dmHashTable
+{
+public:
+    dmHashTable() : m_Capacity(0) {}
+
+    void        SetCapacity(uint32_t table_size, uint32_t capacity) { (void)table_size; assert(capacity >= m_Map.size()); m_Capacity = capacity; }
+    uint32_t    Capacity() const    { return m_Capacity; }
+    uint32_t    Size() const        { return (uint32_t)m_Map.size(); }
+    bool        Full() const        { return m_Map.size() >= m_Capacity; }
+    bool        Empty() const       { return m_Map.empty(); }
+
+    void Put(KEY key, const T& value)
+    {
+        if (!m_Map.count(key))
+            assert(!Full());
+        m_Map[key] = value;
+    }
+
+    T* Get(KEY key)
+    {
+        typename std::map<KEY, T>::iterator it = m_Map.find(key);
+        return it == m_Map.end() ? 0 : &it->second;
+    }
+
+    void Erase(KEY key)     { assert(m_Map.count(key)); m_Map.erase(key); }
+    void Clear()            { m_Map.clear(); }
+
+    template <typename CONTEXT>
+    void Iterate(void (*callback)(CONTEXT* context, const KEY* key, T* value), CONTEXT* context)
+    {
+        for (typename std::map<KEY, T>::iterator it = m_Map.begin(); it != m_Map.end(); ++it)
+            callback(context, &it->first, &it->second);
+    }
+
+private:
+    std::map<KEY, T>    m_Map;
+    uint32_t            m_Capacity;
+};
+
+template <typename T> class dmHashTable32 : public dmHashTable<uint32_t, T> {};
+template <typename T> class dmHashTable64 : public dmHashTable<uint64_t, T> {};
+
+#endif // DMSDK_HASHTABLE_H
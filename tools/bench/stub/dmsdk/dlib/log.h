@@ -0,0 +1,11 @@
+#ifndef DMSDK_LOG_H
+#define DMSDK_LOG_H
+
+#include <stdio.h>
+
+// Written to stderr, so they don't mix with the results on stdout
+#define dmLogInfo(...)      (fprintf(stderr, "INFO: " __VA_ARGS__), fprintf(stderr, "\n"))
+#define dmLogWarning(...)   (fprintf(stderr, "WARNING: " __VA_ARGS__), fprintf(stderr, "\n"))
+#define dmLogError(...)     (fprintf(stderr, "ERROR: " __VA_ARGS__), fprintf(stderr, "\n"))
+
+#endif // DMSDK_LOG_H
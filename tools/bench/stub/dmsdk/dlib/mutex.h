@@ -0,0 +1,28 @@
+#ifndef DMSDK_MUTEX_H
+#define DMSDK_MUTEX_H
+
+#include <pthread.h>
+
+namespace dmMutex
+{
+    typedef pthread_mutex_t* HMutex;
+
+    HMutex  New();
+    void    Delete(HMutex mutex);
+    void    Lock(HMutex mutex);
+    bool    TryLock(HMutex mutex);
+    void    Unlock(HMutex mutex);
+
+    struct ScopedLock
+    {
+        HMutex m_Mutex;
+        ScopedLock(HMutex mutex) : m_Mutex(mutex) { Lock(m_Mutex); }
+        ~ScopedLock() { Unlock(m_Mutex); }
+    };
+}
+
+#define DM_MUTEX_PASTE(x, y) x ## y
+#define DM_MUTEX_NAME(x, y) DM_MUTEX_PASTE(x, y)
+#define DM_MUTEX_SCOPED_LOCK(mutex) dmMutex::ScopedLock DM_MUTEX_NAME(scoped_lock_, __LINE__)(mutex)
+
+#endif // DMSDK_MUTEX_H
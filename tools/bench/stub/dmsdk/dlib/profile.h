@@ -0,0 +1,78 @@
+#ifndef DMSDK_PROFILE_H
+#define DMSDK_PROFILE_H
+
+#include <stdint.h>
+
+typedef uint32_t ProfileIdx;
+#define PROFILE_PROPERTY_INVALID_IDX 0xFFFFFFFF
+
+enum ProfilePropertyFlags
+{
+    PROFILE_PROPERTY_NONE           = 0,
+    PROFILE_PROPERTY_FRAME_RESET    = 1,
+};
+
+enum ProfilePropertyType
+{
+    PROFILE_PROPERTY_TYPE_BOOL,
+    PROFILE_PROPERTY_TYPE_S32,
+    PROFILE_PROPERTY_TYPE_U32,
+    PROFILE_PROPERTY_TYPE_F32,
+    PROFILE_PROPERTY_TYPE_S64,
+    PROFILE_PROPERTY_TYPE_U64,
+    PROFILE_PROPERTY_TYPE_F64,
+    PROFILE_PROPERTY_TYPE_GROUP,
+};
+
+union ProfilePropertyValue
+{
+    bool        m_Bool;
+    int32_t     m_S32;
+    uint32_t    m_U32;
+    float       m_F32;
+    int64_t     m_S64;
+    uint64_t    m_U64;
+    double      m_F64;
+};
+
+struct ProfileListener
+{
+    void* (*m_Create)();
+    void  (*m_Destroy)(void* ctx);
+    void  (*m_SetThreadName)(void* ctx, const char* name);
+
+    void  (*m_FrameBegin)(void* ctx);
+    void  (*m_FrameEnd)(void* ctx);
+    void  (*m_ScopeBegin)(void* ctx, const char* name, uint64_t name_hash);
+    void  (*m_ScopeEnd)(void* ctx, const char* name, uint64_t name_hash);
+
+    void  (*m_LogText)(void* ctx, const char* text);
+
+    void  (*m_CreatePropertyGroup)(void* ctx, const char* name, const char* desc, ProfileIdx idx, ProfileIdx parent);
+    void  (*m_CreatePropertyBool)(void* ctx, const char* name, const char* desc, int value, uint32_t flags, ProfileIdx idx, ProfileIdx parent);
+    void  (*m_CreatePropertyS32)(void* ctx, const char* name, const char* desc, int32_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent);
+    void  (*m_CreatePropertyU32)(void* ctx, const char* name, const char* desc, uint32_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent);
+    void  (*m_CreatePropertyF32)(void* ctx, const char* name, const char* desc, float value, uint32_t flags, ProfileIdx idx, ProfileIdx parent);
+    void  (*m_CreatePropertyS64)(void* ctx, const char* name, const char* desc, int64_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent);
+    void  (*m_CreatePropertyU64)(void* ctx, const char* name, const char* desc, uint64_t value, uint32_t flags, ProfileIdx idx, ProfileIdx parent);
+    void  (*m_CreatePropertyF64)(void* ctx, const char* name, const char* desc, double value, uint32_t flags, ProfileIdx idx, ProfileIdx parent);
+
+    void  (*m_PropertySetBool)(void* ctx, ProfileIdx idx, int v);
+    void  (*m_PropertySetS32)(void* ctx, ProfileIdx idx, int32_t v);
+    void  (*m_PropertySetU32)(void* ctx, ProfileIdx idx, uint32_t v);
+    void  (*m_PropertySetF32)(void* ctx, ProfileIdx idx, float v);
+    void  (*m_PropertySetS64)(void* ctx, ProfileIdx idx, int64_t v);
+    void  (*m_PropertySetU64)(void* ctx, ProfileIdx idx, uint64_t v);
+    void  (*m_PropertySetF64)(void* ctx, ProfileIdx idx, double v);
+    void  (*m_PropertyAddS32)(void* ctx, ProfileIdx idx, int32_t v);
+    void  (*m_PropertyAddU32)(void* ctx, ProfileIdx idx, uint32_t v);
+    void  (*m_PropertyAddF32)(void* ctx, ProfileIdx idx, float v);
+    void  (*m_PropertyAddS64)(void* ctx, ProfileIdx idx, int64_t v);
+    void  (*m_PropertyAddU64)(void* ctx, ProfileIdx idx, uint64_t v);
+    void  (*m_PropertyAddF64)(void* ctx, ProfileIdx idx, double v);
+    void  (*m_PropertyReset)(void* ctx, ProfileIdx idx);
+};
+
+void ProfileRegisterProfiler(const char* name, ProfileListener* profiler);
+
+#endif // DMSDK_PROFILE_H
@@ -0,0 +1,23 @@
+#ifndef DMSDK_THREAD_H
+#define DMSDK_THREAD_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+namespace dmThread
+{
+    typedef pthread_t       Thread;
+    typedef pthread_key_t   TlsKey;
+    typedef void (*ThreadStart)(void* arg);
+
+    Thread  New(ThreadStart thread_start, uint32_t stack_size, void* arg, const char* name);
+    void    Join(Thread thread);
+    Thread  GetCurrentThread();
+
+    TlsKey  AllocTls();
+    void    FreeTls(TlsKey key);
+    void    SetTlsValue(TlsKey key, void* value);
+    void*   GetTlsValue(TlsKey key);
+}
+
+#endif // DMSDK_THREAD_H
@@ -0,0 +1,12 @@
+#ifndef DMSDK_TIME_H
+#define DMSDK_TIME_H
+
+#include <stdint.h>
+
+namespace dmTime
+{
+    uint64_t    GetTime(); // Microseconds
+    void        Sleep(uint32_t useconds);
+}
+
+#endif // DMSDK_TIME_H
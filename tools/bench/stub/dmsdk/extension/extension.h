@@ -0,0 +1,51 @@
+#ifndef DMSDK_EXTENSION_H
+#define DMSDK_EXTENSION_H
+
+#include <dmsdk/dlib/configfile.h>
+
+struct lua_State;
+
+namespace dmExtension
+{
+    enum Result
+    {
+        RESULT_OK           = 0,
+        RESULT_INIT_ERROR   = -1,
+    };
+
+    struct AppParams
+    {
+        dmConfigFile::HConfig   m_ConfigFile;
+    };
+
+    struct Params
+    {
+        dmConfigFile::HConfig   m_ConfigFile;
+        lua_State*              m_L;
+    };
+
+    typedef Result (*FAppInitialize)(AppParams* params);
+    typedef Result (*FAppFinalize)(AppParams* params);
+    typedef Result (*FInitialize)(Params* params);
+    typedef Result (*FUpdate)(Params* params);
+    typedef Result (*FFinalize)(Params* params);
+
+    struct Desc
+    {
+        const char*     m_Name;
+        FAppInitialize  m_AppInitialize;
+        FAppFinalize    m_AppFinalize;
+        FInitialize     m_Initialize;
+        FUpdate         m_Update;
+        FFinalize       m_Finalize;
+    };
+
+    // The one extension in the process, there's no engine to register it with
+    void Register(Desc* desc);
+}
+
+#define DM_DECLARE_EXTENSION(symbol, name, app_init, app_final, init, update, on_event, final) \
+    static dmExtension::Desc symbol ## Desc = { name, app_init, app_final, init, update, final }; \
+    static struct symbol ## Registrar { symbol ## Registrar() { dmExtension::Register(&symbol ## Desc); } } symbol ## RegistrarInstance;
+
+#endif // DMSDK_EXTENSION_H
@@ -0,0 +1,22 @@
+#ifndef DMSDK_SCRIPT_H
+#define DMSDK_SCRIPT_H
+
+// Lua 5.1 or LuaJIT, from LUA_CFLAGS in the Makefile
+extern "C"
+{
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+}
+
+namespace dmScript
+{
+    struct LuaCallbackInfo;
+
+    LuaCallbackInfo*    CreateCallback(lua_State* L, int callback_stack_index);
+    bool                IsCallbackValid(LuaCallbackInfo* cbk);
+    void                DestroyCallback(LuaCallbackInfo* cbk);
+    bool                InvokeCallback(LuaCallbackInfo* cbk, void (*fn)(lua_State* L, void* ctx), void* ctx);
+}
+
+#endif // DMSDK_SCRIPT_H
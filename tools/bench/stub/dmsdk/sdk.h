@@ -0,0 +1,13 @@
+// Minimal stand-in for the Defold SDK, with only what the extension uses. See tools/bench/Makefile
+#ifndef DMSDK_SDK_H
+#define DMSDK_SDK_H
+
+#include <dmsdk/dlib/array.h>
+#include <dmsdk/dlib/configfile.h>
+#include <dmsdk/dlib/hash.h>
+#include <dmsdk/dlib/hashtable.h>
+#include <dmsdk/dlib/log.h>
+#include <dmsdk/extension/extension.h>
+#include <dmsdk/script/script.h>
+
+#endif // DMSDK_SDK_H
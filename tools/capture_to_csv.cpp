@@ -0,0 +1,266 @@
+// Converts a profile capture (see defold-profile/src/capture_format.h) into a csv file,
+// with one row per frame and one column per property.
+//
+// Build: g++ -O2 -o capture_to_csv tools/capture_to_csv.cpp
+// Usage: capture_to_csv <capture file> [<csv file>]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "../defold-profile/src/capture_format.h"
+
+// The engine properties are below 0x10000, and the ones owned by the extension follow them
+static const uint64_t g_MaxPropertyIndex = 0x1FFFF;
+
+struct CaptureProperty
+{
+    std::string m_Name;
+    std::string m_Path;
+    uint32_t    m_Parent; // index + 1, 0 = no parent
+    uint8_t     m_Type;
+    bool        m_Valid;
+    uint64_t    m_Value;
+};
+
+struct Reader
+{
+    const uint8_t*  m_Cursor;
+    const uint8_t*  m_End;
+    bool            m_Error;
+
+    bool AtEnd() const
+    {
+        return m_Cursor >= m_End;
+    }
+
+    uint64_t Varint()
+    {
+        uint64_t v = 0;
+        uint32_t n = m_Error ? 0 : CaptureReadVarint(m_Cursor, m_End, &v);
+        if (!n)
+        {
+            m_Error = true;
+            return 0;
+        }
+        m_Cursor += n;
+        return v;
+    }
+
+    uint8_t U8()
+    {
+        if (m_Error || m_Cursor >= m_End)
+        {
+            m_Error = true;
+            return 0;
+        }
+        return *m_Cursor++;
+    }
+
+    const char* Bytes(uint64_t size)
+    {
+        if (m_Error || (uint64_t)(m_End - m_Cursor) < size)
+        {
+            m_Error = true;
+            return 0;
+        }
+        const char* p = (const char*)m_Cursor;
+        m_Cursor += size;
+        return p;
+    }
+};
+
+static CaptureProperty* GetProperty(std::vector<CaptureProperty>& properties, uint64_t index)
+{
+    if (index >= properties.size())
+        properties.resize(index + 1, CaptureProperty());
+    return &properties[index];
+}
+
+static const std::string& GetPath(std::vector<CaptureProperty>& properties, uint32_t index, uint32_t depth)
+{
+    CaptureProperty* property = &properties[index];
+    if (!property->m_Path.empty() || depth > 64)
+        return property->m_Path;
+
+    // The root group isn't part of the path
+    uint32_t parent = property->m_Parent;
+    if (parent == 0)
+        return property->m_Path;
+
+    const std::string& parent_path = parent - 1 < properties.size() ? GetPath(properties, parent - 1, depth + 1) : std::string();
+    property->m_Path = parent_path.empty() ? property->m_Name : parent_path + "/" + property->m_Name;
+    return property->m_Path;
+}
+
+static void WriteValue(FILE* out, uint8_t type, uint64_t value)
+{
+    switch (type)
+    {
+        case CAPTURE_TYPE_BOOL: fprintf(out, "%d", value ? 1 : 0); break;
+        case CAPTURE_TYPE_S32:
+        case CAPTURE_TYPE_S64:  fprintf(out, "%lld", (long long)(int64_t)value); break;
+        case CAPTURE_TYPE_U32:
+        case CAPTURE_TYPE_U64:  fprintf(out, "%llu", (unsigned long long)value); break;
+        case CAPTURE_TYPE_F32:  { uint32_t bits = (uint32_t)value; float f; memcpy(&f, &bits, sizeof(f)); fprintf(out, "%.9g", f); } break;
+        case CAPTURE_TYPE_F64:  { double d; memcpy(&d, &value, sizeof(d)); fprintf(out, "%.17g", d); } break;
+        default: break;
+    }
+}
+
+// Reads all the records, and writes a csv row after each frame record (if out is set)
+static bool ReadCapture(const uint8_t* data, size_t size, std::vector<CaptureProperty>& properties,
+                        FILE* out, const std::vector<uint32_t>* columns)
+{
+    Reader reader = { data + 5, data + size, false };
+    uint64_t frame = 0;
+    uint64_t time = 0;
+    uint64_t dropped = 0;
+
+    for (uint32_t i = 0; i < properties.size(); ++i)
+        properties[i].m_Value = 0;
+
+    while (!reader.AtEnd() && !reader.m_Error)
+    {
+        uint8_t record = reader.U8();
+        switch (record)
+        {
+        case CAPTURE_RECORD_PROPERTY:
+            {
+                uint64_t index  = reader.Varint();
+                uint64_t parent = reader.Varint();
+                uint8_t type    = reader.U8();
+                reader.Varint(); // flags
+                uint64_t length = reader.Varint();
+                const char* name = reader.Bytes(length);
+                if (reader.m_Error || index > g_MaxPropertyIndex)
+                    break;
+
+                CaptureProperty* property = GetProperty(properties, index);
+                property->m_Name.assign(name, (size_t)length);
+                property->m_Parent = (uint32_t)parent;
+                property->m_Type = type;
+                property->m_Valid = true;
+            }
+            break;
+
+        case CAPTURE_RECORD_FRAME:
+            {
+                frame += reader.Varint();
+                time += reader.Varint();
+                uint64_t count = reader.Varint();
+                int64_t index = 0;
+                for (uint64_t i = 0; i < count && !reader.m_Error; ++i)
+                {
+                    index += CaptureZigZagDecode(reader.Varint());
+                    uint64_t delta = reader.Varint();
+                    if (reader.m_Error || index < 0 || (uint64_t)index >= properties.size())
+                    {
+                        reader.m_Error = true;
+                        break;
+                    }
+                    CaptureProperty* property = &properties[index];
+                    if (CaptureIsFloatType(property->m_Type))
+                        property->m_Value ^= delta;
+                    else
+                        property->m_Value += (uint64_t)CaptureZigZagDecode(delta);
+                }
+
+                if (out && columns && !reader.m_Error)
+                {
+                    fprintf(out, "%llu,%llu", (unsigned long long)frame, (unsigned long long)time);
+                    for (size_t c = 0; c < columns->size(); ++c)
+                    {
+                        const CaptureProperty* property = &properties[(*columns)[c]];
+                        fputc(',', out);
+                        WriteValue(out, property->m_Type, property->m_Value);
+                    }
+                    fputc('\n', out);
+                }
+            }
+            break;
+
+        case CAPTURE_RECORD_DROPPED:
+            dropped += reader.Varint();
+            break;
+
+        default:
+            fprintf(stderr, "Unknown record type %u at offset %ld\n", record, (long)(reader.m_Cursor - data - 1));
+            return false;
+        }
+    }
+
+    if (reader.m_Error)
+        fprintf(stderr, "Capture is truncated, the last frame was skipped\n");
+    if (out && columns && dropped)
+        fprintf(stderr, "%llu frames were dropped while capturing\n", (unsigned long long)dropped);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <capture file> [<csv file>]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in)
+    {
+        fprintf(stderr, "Failed to open '%s'\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[64 * 1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    fclose(in);
+
+    if (data.size() < 5 || memcmp(&data[0], CAPTURE_MAGIC, 4) != 0)
+    {
+        fprintf(stderr, "'%s' is not a profile capture\n", argv[1]);
+        return 1;
+    }
+    if (data[4] != CAPTURE_VERSION)
+    {
+        fprintf(stderr, "Unsupported capture version %u (expected %u)\n", data[4], CAPTURE_VERSION);
+        return 1;
+    }
+
+    // First pass collects the properties, since they may be registered after the first frame
+    std::vector<CaptureProperty> properties;
+    if (!ReadCapture(&data[0], data.size(), properties, 0, 0))
+        return 1;
+
+    std::vector<uint32_t> columns;
+    for (uint32_t i = 0; i < properties.size(); ++i)
+    {
+        if (properties[i].m_Valid && properties[i].m_Type != CAPTURE_TYPE_GROUP)
+            columns.push_back(i);
+    }
+
+    FILE* out = argc > 2 ? fopen(argv[2], "wb") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "Failed to open '%s'\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "frame,time_us");
+    for (size_t c = 0; c < columns.size(); ++c)
+    {
+        const std::string& path = GetPath(properties, columns[c], 0);
+        fprintf(out, ",%s", path.c_str());
+    }
+    fputc('\n', out);
+
+    bool result = ReadCapture(&data[0], data.size(), properties, out, &columns);
+    if (out != stdout)
+        fclose(out);
+    return result ? 0 : 1;
+}
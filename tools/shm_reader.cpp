@@ -0,0 +1,156 @@
+// Sample reader for the shared memory export (see defold-profile/src/shm_format.h).
+// Prints the properties of the running game every interval, optionally only those whose path starts with a prefix.
+//
+// Build: g++ -O2 -o shm_reader tools/shm_reader.cpp -lrt
+// Usage: shm_reader <shm name> [<path prefix>] [<interval ms>]
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "../defold-profile/src/shm_format.h"
+
+enum ValueType // Same values as ProfilePropertyType
+{
+    TYPE_BOOL,
+    TYPE_S32,
+    TYPE_U32,
+    TYPE_F32,
+    TYPE_S64,
+    TYPE_U64,
+    TYPE_F64,
+    TYPE_GROUP,
+};
+
+static ShmHeader* OpenSegment(const char* name, size_t* size)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    void* memory = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ShmHeader))
+        memory = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        return 0;
+
+    ShmHeader* header = (ShmHeader*)memory;
+    if (memcmp(header->m_Magic, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0 || header->m_Version != SHM_VERSION
+        || header->m_HeaderSize != sizeof(ShmHeader) || ShmGetSize(header->m_Capacity) > (size_t)st.st_size)
+    {
+        munmap(memory, st.st_size);
+        return 0;
+    }
+    *size = st.st_size;
+    return header;
+}
+
+static void PrintValue(uint8_t type, uint64_t bits)
+{
+    uint32_t low = (uint32_t)bits; // The 32 bit types are in the low bytes (little endian)
+    switch (type)
+    {
+        case TYPE_BOOL: printf("%s", (low & 0xFF) ? "true" : "false"); break;
+        case TYPE_S32:  printf("%d", (int32_t)low); break;
+        case TYPE_U32:  printf("%u", low); break;
+        case TYPE_F32:  { float f; memcpy(&f, &low, sizeof(f)); printf("%g", f); } break;
+        case TYPE_S64:  printf("%lld", (long long)(int64_t)bits); break;
+        case TYPE_U64:  printf("%llu", (unsigned long long)bits); break;
+        case TYPE_F64:  { double d; memcpy(&d, &bits, sizeof(d)); printf("%g", d); } break;
+        default: break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <shm name> [<path prefix>] [<interval ms>]\n", argv[0]);
+        return 1;
+    }
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s%s", argv[1][0] == '/' ? "" : "/", argv[1]);
+    const char* prefix = argc > 2 ? argv[2] : "";
+    size_t prefix_length = strlen(prefix);
+    int interval = argc > 3 ? atoi(argv[3]) : 1000;
+
+    size_t size = 0;
+    ShmHeader* header = OpenSegment(name, &size);
+    if (!header)
+    {
+        fprintf(stderr, "Failed to open shared memory '%s'\n", name);
+        return 1;
+    }
+
+    uint32_t capacity = header->m_Capacity;
+    std::vector<ShmProperty> properties(capacity);
+    std::vector<uint64_t> values(capacity);
+    uint32_t last_frame = 0;
+
+    while (true)
+    {
+        // Copy everything, and retry if the game wrote to the segment in the meantime
+        uint32_t count, extension_count, frame;
+        uint64_t time;
+        while (true)
+        {
+            uint32_t sequence = header->m_Sequence.load(std::memory_order_acquire);
+            if (sequence & 1)
+                continue;
+
+            count = header->m_Count;
+            extension_count = header->m_ExtensionCount;
+            frame = header->m_Frame;
+            time = header->m_Time;
+            if (count > capacity)
+                count = capacity;
+            if (extension_count > capacity - count)
+                extension_count = capacity - count;
+
+            // The engine properties from the bottom, and the extension properties from the top
+            uint32_t extension_first = capacity - extension_count;
+            memcpy(properties.data(), ShmGetProperties(header), count * sizeof(ShmProperty));
+            memcpy(values.data(), ShmGetValues(header), count * sizeof(uint64_t));
+            memcpy(&properties[extension_first], ShmGetProperties(header) + extension_first, extension_count * sizeof(ShmProperty));
+            memcpy(&values[extension_first], ShmGetValues(header) + extension_first, extension_count * sizeof(uint64_t));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header->m_Sequence.load(std::memory_order_relaxed) == sequence)
+                break;
+        }
+
+        if (frame != last_frame)
+        {
+            printf("frame %u (%.3f s)\n", frame, time / 1000000.0);
+            for (uint32_t i = 0; i < capacity; ++i)
+            {
+                if (i == count)
+                    i = capacity - extension_count; // Skip the unused slots in between
+                if (i == capacity)
+                    break;
+                const ShmProperty* property = &properties[i];
+                if (!property->m_Valid || property->m_Type == TYPE_GROUP || strncmp(property->m_Path, prefix, prefix_length) != 0)
+                    continue;
+                printf("  %s = ", property->m_Path);
+                PrintValue(property->m_Type, values[i]);
+                printf("\n");
+            }
+            fflush(stdout);
+            last_frame = frame;
+        }
+
+        usleep(interval * 1000);
+    }
+
+    munmap(header, size);
+    return 0;
+}